@@ -0,0 +1,76 @@
+/* apic.c - Functions to interact with the local APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#include "apic.h"
+#include "lib.h"
+#include "sched.h"
+#include "smp.h"
+#include "signal.h"
+
+volatile uint32_t* lapic;
+
+/* Enable the local APIC of the calling CPU and start its timer */
+void
+lapic_init(void)
+{
+	if (lapic == NULL)
+		return;
+
+	/* Accept all priorities and route spurious interrupts */
+	lapic_write(LAPIC_TPR, 0);
+	lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+	/* Periodic scheduler tick */
+	lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+	lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+	lapic_write(LAPIC_TIMER_INIT, LAPIC_TIMER_INIT_COUNT);
+}
+
+/* APIC ID of the calling CPU */
+uint32_t
+lapic_id(void)
+{
+	if (lapic == NULL)
+		return 0;
+
+	return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/* Signal end of interrupt to the local APIC */
+void
+lapic_eoi(void)
+{
+	lapic_write(LAPIC_EOI, 0);
+}
+
+/* Send an INIT or STARTUP inter-processor interrupt */
+void
+lapic_send_ipi(uint32_t apic_id, uint32_t icr)
+{
+	lapic_write(LAPIC_ICR_HIGH, apic_id << ICR_DEST_SHIFT);
+	lapic_write(LAPIC_ICR_LOW, icr);
+
+	/* Wait for the IPI to be accepted */
+	while (lapic_read(LAPIC_ICR_LOW) & ICR_DELIVERY_PENDING);
+}
+
+/* Local APIC timer interrupt, only user code is preempted */
+void
+lapic_timer_handler(uint32_t from_user)
+{
+	cpu_t* cpu = this_cpu();
+
+	cpu->ticks++;
+	lapic_eoi();
+
+	/* Sleeps with a timeout count CPU 0's ticks */
+	if (cpu->id == 0)
+		wake_up(&tick_wq);
+
+	if (from_user) {
+		if (cpu->ticks % ALARM_TICKS == 0)
+			send_signal(cpu->current, SIG_ALARM);
+		schedule();
+	}
+}
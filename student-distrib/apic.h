@@ -0,0 +1,70 @@
+/* apic.h - Defines used in interactions with the local APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+#include "types.h"
+
+#define LAPIC_DEFAULT_BASE 0xFEE00000
+
+/* Local APIC register offsets (in bytes) */
+#define LAPIC_ID		0x020
+#define LAPIC_VER		0x030
+#define LAPIC_TPR		0x080
+#define LAPIC_EOI		0x0B0
+#define LAPIC_SVR		0x0F0
+#define LAPIC_ICR_LOW	0x300
+#define LAPIC_ICR_HIGH	0x310
+#define LAPIC_LVT_TIMER	0x320
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CUR	0x390
+#define LAPIC_TIMER_DIV	0x3E0
+
+#define LAPIC_SVR_ENABLE	0x100
+#define LAPIC_ID_SHIFT		24
+
+/* Interrupt command register fields */
+#define ICR_INIT			0x00000500
+#define ICR_STARTUP			0x00000600
+#define ICR_LEVEL_ASSERT	0x00004000
+#define ICR_DELIVERY_PENDING 0x00001000
+#define ICR_DEST_SHIFT		24
+
+/* Timer */
+#define LAPIC_TIMER_PERIODIC	0x00020000
+#define LAPIC_TIMER_DIV_16		0x3
+#define LAPIC_TIMER_INIT_COUNT	0x00100000
+
+/* Vectors owned by the local APIC */
+#define LAPIC_TIMER_VECTOR		0xF0
+#define LAPIC_SPURIOUS_VECTOR	0xFF
+
+/* Mapped local APIC registers, NULL when the machine has no APIC */
+extern volatile uint32_t* lapic;
+
+/* Read a local APIC register */
+static inline uint32_t lapic_read(uint32_t reg)
+{
+	return lapic[reg >> 2];
+}
+
+/* Write a local APIC register */
+static inline void lapic_write(uint32_t reg, uint32_t val)
+{
+	lapic[reg >> 2] = val;
+}
+
+/* Enable the local APIC of the calling CPU and start its timer */
+void lapic_init(void);
+/* APIC ID of the calling CPU */
+uint32_t lapic_id(void);
+/* Signal end of interrupt to the local APIC */
+void lapic_eoi(void);
+/* Send an INIT or STARTUP inter-processor interrupt */
+void lapic_send_ipi(uint32_t apic_id, uint32_t icr);
+/* Local APIC timer interrupt */
+void lapic_timer_handler(uint32_t from_user);
+
+#endif /* _APIC_H */
@@ -0,0 +1,409 @@
+/* ata.c - IDE/ATA disk driver. Each block request becomes one command,
+ * using bus-master DMA straight into the request's buffers when the PCI
+ * IDE controller has it and the drive supports it, PIO otherwise. The
+ * drive's interrupt advances the command and reports its completion.
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ata.h"
+#include "pci.h"
+#include "irq.h"
+#include "page_init.h"
+#include "lib.h"
+
+static ata_channel_t primary = {
+	.io = ATA_PRIMARY_IO,
+	.ctrl = ATA_PRIMARY_CTRL,
+	.irq = ATA_PRIMARY_IRQ,
+	.lock = SPIN_LOCK_UNLOCKED,
+};
+
+static ata_drive_t drives[ATA_MAX_DRIVES];
+static const char* drive_names[ATA_MAX_DRIVES] = { "hda", "hdb" };
+
+/* DMA descriptors of the command in flight */
+static ata_prd_t prd_table[ATA_MAX_PRDS] __attribute__((aligned (ATA_PRDT_ALIGN)));
+
+/* Wait the 400ns a drive needs after a select, by reading alternate status */
+static void
+ata_delay(ata_channel_t* ch)
+{
+	inb(ch->ctrl);
+	inb(ch->ctrl);
+	inb(ch->ctrl);
+	inb(ch->ctrl);
+}
+
+/* Poll until the drive is not busy, returns the status or -1 on timeout */
+static int32_t
+ata_wait_ready(ata_channel_t* ch)
+{
+	uint32_t status, i;
+
+	for (i = 0; i < ATA_POLL_LIMIT; i++) {
+		status = inb(ch->ctrl);
+		if (!(status & ATA_SR_BSY))
+			return status;
+	}
+
+	return -1;
+}
+
+/* Select a drive and write the LBA28 address and sector count */
+static void
+ata_setup(ata_drive_t* drive, uint32_t lba, uint32_t count)
+{
+	ata_channel_t* ch = drive->chan;
+
+	outb(ATA_DRIVE_LBA | (drive->slave << ATA_DRIVE_SLAVE_SHIFT) | ((lba >> 24) & 0xF), ch->io + ATA_REG_DRIVE);
+	ata_delay(ch);
+	outb(count & 0xFF, ch->io + ATA_REG_SECCOUNT);
+	outb(lba & 0xFF, ch->io + ATA_REG_LBA_LO);
+	outb((lba >> 8) & 0xFF, ch->io + ATA_REG_LBA_MID);
+	outb((lba >> 16) & 0xFF, ch->io + ATA_REG_LBA_HI);
+}
+
+/* Address of the n-th sector of a request */
+static uint8_t*
+req_sector(blk_req_t* req, uint32_t n)
+{
+	return req->bh[n / SECTORS_PER_BLK]->data + (n % SECTORS_PER_BLK) * SECTOR_SIZE;
+}
+
+/* Fill the PRD table with a request's buffers, splitting them at 64KB
+ * boundaries. The kernel page is identity mapped, so virtual is physical.
+ * Returns 0, or -1 if a buffer is out of reach of DMA. */
+static int32_t
+ata_build_prds(blk_req_t* req)
+{
+	uint32_t addr, len, chunk;
+	uint32_t i, n = 0;
+
+	for (i = 0; i < req->nsegs; i++) {
+		addr = (uint32_t)req->bh[i]->data;
+		len = BLK_SIZE;
+		if ((addr & 1) || addr < KERNEL_ADDR || addr + len > ATA_DMA_LIMIT)
+			return -1;
+
+		while (len > 0) {
+			chunk = ATA_DMA_BOUNDARY - (addr & (ATA_DMA_BOUNDARY - 1));
+			if (chunk > len)
+				chunk = len;
+			prd_table[n].addr = addr;
+			prd_table[n].count = chunk & 0xFFFF;
+			prd_table[n].flags = 0;
+			n++;
+			addr += chunk;
+			len -= chunk;
+		}
+	}
+	prd_table[n - 1].flags = ATA_PRD_EOT;
+
+	return 0;
+}
+
+/*
+ * ata_issue
+ *   DESCRIPTION: Starts the command for a request on an idle channel. PIO
+ *                writes send their first sector here, every other sector
+ *                moves in the interrupt handler.
+ *   INPUTS: ata_channel_t* ch - idle channel, locked
+ *           ata_drive_t* drive - target drive
+ *           blk_req_t* req - request, at most BLK_MAX_SEGS blocks
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the command is running, -1 if the drive stayed busy
+ *                 or failed the PIO write handshake; the channel is left
+ *                 idle and the request must be failed by the caller
+ */
+static int32_t
+ata_issue(ata_channel_t* ch, ata_drive_t* drive, blk_req_t* req)
+{
+	uint32_t bmcmd, i;
+
+	if (ata_wait_ready(ch) == -1) {
+		ch->errors++;
+		return -1;
+	}
+
+	ch->drive = drive;
+	ch->req = req;
+	ch->error = 0;
+	ch->flushing = 0;
+	ch->sector = 0;
+
+	ata_setup(drive, req->sector, req->count);
+
+	if (drive->dma && ata_build_prds(req) == 0) {
+		bmcmd = (req->dir == BLK_READ) ? BM_CMD_READ : 0;
+		ch->dma = 1;
+		outl((uint32_t)prd_table, ch->bmide + BM_REG_PRDT);
+		outb(bmcmd, ch->bmide + BM_REG_COMMAND);
+		outb(inb(ch->bmide + BM_REG_STATUS) | BM_ST_IRQ | BM_ST_ERR, ch->bmide + BM_REG_STATUS);
+		outb((req->dir == BLK_READ) ? ATA_CMD_READ_DMA : ATA_CMD_WRITE_DMA, ch->io + ATA_REG_COMMAND);
+		outb(bmcmd | BM_CMD_START, ch->bmide + BM_REG_COMMAND);
+		ch->dma_cmds++;
+		return 0;
+	}
+
+	ch->dma = 0;
+	ch->pio_cmds++;
+	if (req->dir == BLK_READ) {
+		outb(ATA_CMD_READ_PIO, ch->io + ATA_REG_COMMAND);
+		return 0;
+	}
+
+	outb(ATA_CMD_WRITE_PIO, ch->io + ATA_REG_COMMAND);
+	for (i = 0; (inb(ch->ctrl) & (ATA_SR_BSY | ATA_SR_DRQ)) != ATA_SR_DRQ; i++) {
+		if (i == ATA_POLL_LIMIT || (inb(ch->ctrl) & (ATA_SR_ERR | ATA_SR_DF))) {
+			ch->drive = NULL;
+			ch->req = NULL;
+			ch->errors++;
+			return -1;
+		}
+	}
+	outsw(ch->io + ATA_REG_DATA, req_sector(req, 0), SECTOR_SIZE / 2);
+	ch->sector = 1;
+	return 0;
+}
+
+/*
+ * ata_irq
+ *   DESCRIPTION: Interrupt handler of a channel. A DMA command is finished
+ *                when the bus master saw the interrupt; a PIO command moves
+ *                one sector per interrupt until none remain. Writes are
+ *                followed by a cache flush. A finished command completes
+ *                its block request and lets the other drive's waiting
+ *                request start.
+ *   INPUTS: uint32_t irq_num - IRQ line
+ *           void* ctx - the channel
+ *   OUTPUTS: none
+ *   RETURN VALUE: IRQ_HANDLED, or IRQ_NONE if the bus master did not interrupt
+ */
+static int32_t
+ata_irq(uint32_t irq_num, void* ctx)
+{
+	ata_channel_t* ch = ctx;
+	ata_drive_t* drive;
+	blk_req_t* req;
+	ata_drive_t* failed[ATA_MAX_DRIVES];
+	uint32_t status, bmst, i, nfailed = 0;
+	uint32_t done = 0;
+	int32_t error;
+
+	spin_lock(&ch->lock);
+	if ((drive = ch->drive) == NULL) {
+		inb(ch->io + ATA_REG_STATUS);
+		spin_unlock(&ch->lock);
+		return IRQ_HANDLED;
+	}
+	req = ch->req;
+
+	if (ch->dma) {
+		bmst = inb(ch->bmide + BM_REG_STATUS);
+		if (!(bmst & BM_ST_IRQ)) {
+			spin_unlock(&ch->lock);
+			return IRQ_NONE;
+		}
+
+		/* Stop the engine, clear its status, then acknowledge the drive */
+		outb((req->dir == BLK_READ) ? BM_CMD_READ : 0, ch->bmide + BM_REG_COMMAND);
+		outb(bmst | BM_ST_IRQ | BM_ST_ERR, ch->bmide + BM_REG_STATUS);
+		status = inb(ch->io + ATA_REG_STATUS);
+		if ((bmst & BM_ST_ERR) || (status & (ATA_SR_ERR | ATA_SR_DF)))
+			ch->error = 1;
+		done = 1;
+	} else {
+		status = inb(ch->io + ATA_REG_STATUS);
+		if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+			ch->error = 1;
+			done = 1;
+		} else if (ch->flushing) {
+			done = 1;
+		} else if (req->dir == BLK_READ) {
+			insw(ch->io + ATA_REG_DATA, req_sector(req, ch->sector), SECTOR_SIZE / 2);
+			done = (++ch->sector == req->count);
+		} else if (ch->sector == req->count) {
+			/* The last sector is written */
+			done = 1;
+		} else {
+			outsw(ch->io + ATA_REG_DATA, req_sector(req, ch->sector), SECTOR_SIZE / 2);
+			ch->sector++;
+		}
+	}
+
+	if (!done) {
+		spin_unlock(&ch->lock);
+		return IRQ_HANDLED;
+	}
+
+	if (!ch->error && req->dir == BLK_WRITE && !ch->flushing) {
+		ch->flushing = 1;
+		ch->dma = 0;
+		outb(ATA_CMD_FLUSH, ch->io + ATA_REG_COMMAND);
+		spin_unlock(&ch->lock);
+		return IRQ_HANDLED;
+	}
+
+	error = ch->error;
+	if (error)
+		ch->errors++;
+	ch->drive = NULL;
+	ch->req = NULL;
+	for (i = 0; i < ATA_MAX_DRIVES; i++) {
+		if (ch->pending[i] != NULL) {
+			req = ch->pending[i];
+			ch->pending[i] = NULL;
+			if (ata_issue(ch, &drives[i], req) == 0)
+				break;
+			failed[nfailed++] = &drives[i];
+		}
+	}
+	spin_unlock(&ch->lock);
+
+	blk_complete(&drive->blk, error);
+	for (i = 0; i < nfailed; i++)
+		blk_complete(&failed[i]->blk, 1);
+	return IRQ_HANDLED;
+}
+
+/*
+ * ata_start
+ *   DESCRIPTION: Block device start operation. The request waits on the
+ *                channel while the other drive's command runs.
+ *   INPUTS: blk_dev_t* dev - the drive's block device
+ *           blk_req_t* req - request to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the request runs or waits, -1 if the drive timed out
+ */
+static int32_t
+ata_start(blk_dev_t* dev, blk_req_t* req)
+{
+	ata_drive_t* drive = dev->priv;
+	ata_channel_t* ch = drive->chan;
+	uint32_t flags;
+	int32_t ret = 0;
+
+	spin_lock_irqsave(&ch->lock, flags);
+	if (ch->drive == NULL)
+		ret = ata_issue(ch, drive, req);
+	else
+		ch->pending[drive->slave] = req;
+	spin_unlock_irqrestore(&ch->lock, flags);
+
+	return ret;
+}
+
+/*
+ * ata_identify
+ *   DESCRIPTION: Polls IDENTIFY DEVICE on one drive of a channel with its
+ *                interrupt masked
+ *   INPUTS: ata_drive_t* drive - filled in for an LBA-capable ATA drive
+ *           ata_channel_t* ch - channel to probe
+ *           uint32_t slave - 0 for the master, 1 for the slave
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if a usable drive answered, -1 otherwise
+ */
+static int32_t
+ata_identify(ata_drive_t* drive, ata_channel_t* ch, uint32_t slave)
+{
+	uint16_t id[ATA_ID_WORDS];
+	uint32_t status, i;
+
+	outb(ATA_DRIVE_CHS | (slave << ATA_DRIVE_SLAVE_SHIFT), ch->io + ATA_REG_DRIVE);
+	ata_delay(ch);
+	outb(0, ch->io + ATA_REG_SECCOUNT);
+	outb(0, ch->io + ATA_REG_LBA_LO);
+	outb(0, ch->io + ATA_REG_LBA_MID);
+	outb(0, ch->io + ATA_REG_LBA_HI);
+	outb(ATA_CMD_IDENTIFY, ch->io + ATA_REG_COMMAND);
+
+	/* No drive, or nothing on the bus at all */
+	status = inb(ch->io + ATA_REG_STATUS);
+	if (status == 0 || status == 0xFF)
+		return -1;
+
+	for (i = 0; (status & ATA_SR_BSY) && i < ATA_POLL_LIMIT; i++)
+		status = inb(ch->io + ATA_REG_STATUS);
+	if (status & ATA_SR_BSY)
+		return -1;
+
+	/* ATAPI devices abort with their signature in the LBA registers */
+	if (inb(ch->io + ATA_REG_LBA_MID) != 0 || inb(ch->io + ATA_REG_LBA_HI) != 0)
+		return -1;
+
+	for (i = 0; !(status & (ATA_SR_DRQ | ATA_SR_ERR)) && i < ATA_POLL_LIMIT; i++)
+		status = inb(ch->io + ATA_REG_STATUS);
+	if ((status & ATA_SR_ERR) || !(status & ATA_SR_DRQ))
+		return -1;
+
+	insw(ch->io + ATA_REG_DATA, id, ATA_ID_WORDS);
+	if (!(id[ATA_ID_CAPS] & ATA_CAP_LBA))
+		return -1;
+
+	/* Model string, stored as byte-swapped words padded with spaces */
+	for (i = 0; i < ATA_ID_MODEL_LEN / 2; i++) {
+		drive->model[2 * i] = id[ATA_ID_MODEL + i] >> 8;
+		drive->model[2 * i + 1] = id[ATA_ID_MODEL + i] & 0xFF;
+	}
+	for (i = ATA_ID_MODEL_LEN; i > 0 && drive->model[i - 1] == ' '; i--);
+	drive->model[i] = '\0';
+
+	drive->chan = ch;
+	drive->slave = slave;
+	drive->dma = (ch->bmide != 0) && (id[ATA_ID_CAPS] & ATA_CAP_DMA);
+	drive->blk.name = drive_names[slave];
+	drive->blk.sectors = id[ATA_ID_LBA_SECTORS] | (id[ATA_ID_LBA_SECTORS + 1] << 16);
+	drive->blk.start = ata_start;
+	drive->blk.priv = drive;
+
+	return 0;
+}
+
+/*
+ * ata_init
+ *   DESCRIPTION: Finds the bus-master registers of the PCI IDE controller,
+ *                probes both drives of the primary channel and registers
+ *                them as block devices. DMA is only used while the primary
+ *                channel sits on its legacy ports and IRQ.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: unmasks IRQ 14 when a drive is found
+ */
+void
+ata_init(void)
+{
+	ata_channel_t* ch = &primary;
+	uint32_t dev, bar4, i;
+	uint32_t found = 0;
+
+	if (pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &dev) == 0 &&
+		!((pci_read(dev, PCI_CLASS) >> 8) & PCI_IDE_PRIMARY_NATIVE)) {
+		bar4 = pci_read(dev, PCI_BAR4);
+		if (bar4 & PCI_BAR_IO) {
+			ch->bmide = bar4 & PCI_BAR_IO_MASK;
+			pci_write(dev, PCI_COMMAND, pci_read(dev, PCI_COMMAND) | PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+		}
+	}
+
+	/* Probe by polling */
+	outb(ATA_CTRL_NIEN, ch->ctrl);
+	for (i = 0; i < ATA_MAX_DRIVES; i++) {
+		if (ata_identify(&drives[i], ch, i) == -1)
+			continue;
+		printf("%s: %s, %s\n", drives[i].blk.name, drives[i].model, drives[i].dma ? "DMA" : "PIO");
+		found |= 1 << i;
+	}
+	if (!found)
+		return;
+
+	request_irq(ch->irq, ata_irq, ch);
+	inb(ch->io + ATA_REG_STATUS);
+	outb(0, ch->ctrl);
+	enable_irq(ch->irq);
+
+	for (i = 0; i < ATA_MAX_DRIVES; i++) {
+		if (found & (1 << i))
+			blk_register(&drives[i].blk);
+	}
+}
@@ -0,0 +1,128 @@
+/* ata.h - IDE/ATA disk driver: LBA28 PIO and bus-master DMA transfers
+ * of block requests, completed by the drive's interrupt
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ATA_H
+#define _ATA_H
+
+#include "types.h"
+#include "blkdev.h"
+
+/* Primary channel, compatibility mode (QEMU -hda / -hdb) */
+#define ATA_PRIMARY_IO		0x1F0
+#define ATA_PRIMARY_CTRL	0x3F6
+#define ATA_PRIMARY_IRQ		14
+#define ATA_MAX_DRIVES		2		// Master and slave
+
+/* Command block registers (offsets from the I/O base) */
+#define ATA_REG_DATA		0
+#define ATA_REG_ERROR		1
+#define ATA_REG_SECCOUNT	2
+#define ATA_REG_LBA_LO		3
+#define ATA_REG_LBA_MID		4
+#define ATA_REG_LBA_HI		5
+#define ATA_REG_DRIVE		6
+#define ATA_REG_STATUS		7		// Reading it acknowledges the interrupt
+#define ATA_REG_COMMAND		7
+
+/* Status register bits */
+#define ATA_SR_BSY		0x80
+#define ATA_SR_DRDY		0x40
+#define ATA_SR_DF		0x20
+#define ATA_SR_DRQ		0x08
+#define ATA_SR_ERR		0x01
+
+/* Drive/head register: LBA addressing, bit 4 selects the slave */
+#define ATA_DRIVE_LBA	0xE0
+#define ATA_DRIVE_CHS	0xA0
+#define ATA_DRIVE_SLAVE_SHIFT	4
+
+/* Device control register */
+#define ATA_CTRL_NIEN	0x02		// Mask the drive's interrupt
+
+/* Commands */
+#define ATA_CMD_READ_PIO	0x20
+#define ATA_CMD_WRITE_PIO	0x30
+#define ATA_CMD_READ_DMA	0xC8
+#define ATA_CMD_WRITE_DMA	0xCA
+#define ATA_CMD_FLUSH		0xE7
+#define ATA_CMD_IDENTIFY	0xEC
+
+/* IDENTIFY data (word offsets) */
+#define ATA_ID_WORDS		256
+#define ATA_ID_MODEL		27
+#define ATA_ID_MODEL_LEN	40		// Bytes, two per word swapped
+#define ATA_ID_CAPS			49
+#define ATA_ID_LBA_SECTORS	60		// Two words, LBA28 capacity
+#define ATA_CAP_DMA			0x0100
+#define ATA_CAP_LBA			0x0200
+
+/* Bus-master IDE registers (offsets from BAR4, primary channel) */
+#define BM_REG_COMMAND	0
+#define BM_REG_STATUS	2
+#define BM_REG_PRDT		4
+#define BM_CMD_START	0x01
+#define BM_CMD_READ		0x08		// Device to memory
+#define BM_ST_ERR		0x02
+#define BM_ST_IRQ		0x04
+
+/* PCI class of an IDE controller */
+#define PCI_CLASS_STORAGE	0x01
+#define PCI_SUBCLASS_IDE	0x01
+#define PCI_IDE_PRIMARY_NATIVE	0x01	// Prog if bit, primary channel off the legacy ports
+
+#define ATA_DMA_BOUNDARY 0x10000	// A PRD entry may not cross 64KB
+#define ATA_DMA_LIMIT	0x00800000	// End of the identity-mapped kernel page
+#define ATA_PRD_EOT		0x8000
+#define ATA_MAX_PRDS	(BLK_MAX_SEGS * 2)	// A segment crossing 64KB takes two
+#define ATA_PRDT_ALIGN	256			// Table size, keeps it inside one 64KB region
+#define ATA_POLL_LIMIT	100000		// Status reads before a probe gives up
+
+/* Physical region descriptor of a DMA transfer */
+typedef struct ata_prd_t {
+	uint32_t addr;
+	uint16_t count;			// Bytes, 0 means 64KB
+	uint16_t flags;
+} ata_prd_t;
+
+struct ata_drive_t;
+
+/* One IDE channel, running a single command at a time */
+typedef struct ata_channel_t {
+	uint32_t io;
+	uint32_t ctrl;
+	uint32_t bmide;			// Bus-master base, 0 without DMA
+	uint32_t irq;
+	spinlock_t lock;
+
+	/* Command in flight, advanced by the interrupt handler */
+	struct ata_drive_t* drive;	// NULL when the channel is idle
+	blk_req_t* req;
+	uint32_t dma;
+	uint32_t flushing;		// Cache flush after a write
+	uint32_t sector;		// PIO sectors of req moved so far
+	uint32_t error;
+
+	/* Request of the other drive, started when the channel is free */
+	blk_req_t* pending[ATA_MAX_DRIVES];
+
+	/* Statistics */
+	uint32_t pio_cmds;
+	uint32_t dma_cmds;
+	uint32_t errors;
+} ata_channel_t;
+
+/* A drive found by IDENTIFY */
+typedef struct ata_drive_t {
+	blk_dev_t blk;
+	ata_channel_t* chan;
+	uint32_t slave;
+	uint32_t dma;
+	int8_t model[ATA_ID_MODEL_LEN + 1];
+} ata_drive_t;
+
+/* Probe the primary channel and register its drives */
+void ata_init(void);
+
+#endif /* _ATA_H */
@@ -0,0 +1,644 @@
+/* blkdev.c - Block device registry, request queues and buffer cache.
+ * Cached blocks are found through a hash on (device, block) and reused
+ * least recently used first; dirty blocks are written back before their
+ * buffer is reused. Reads and writes of buffers become requests that the
+ * device's I/O scheduler merges and orders; the device runs one at a time.
+ * vim:ts=4 noexpandtab
+ */
+
+#include "blkdev.h"
+#include "iosched.h"
+#include "sched.h"
+#include "lib.h"
+
+#define bcache_hash(dev, block) ((((uint32_t)(dev) >> 4) ^ (block)) & (BCACHE_HASH - 1))
+
+static blk_dev_t* blk_devs[MAX_BLK_DEVS];
+static uint32_t num_blk_devs;
+
+/* Buffers are page aligned kernel memory so drivers can DMA into them */
+static uint8_t buf_data[BCACHE_BLOCKS][BLK_SIZE] __attribute__((aligned (BLK_SIZE)));
+static buf_head_t buffers[BCACHE_BLOCKS];
+static buf_head_t* hash_table[BCACHE_HASH];
+
+/* Every buffer in use order, least recently used at the head */
+static buf_head_t* lru_head;
+static buf_head_t* lru_tail;
+
+static volatile uint32_t nr_unheld = BCACHE_BLOCKS;
+static spinlock_t bcache_lock = SPIN_LOCK_UNLOCKED;
+static wait_queue_t bcache_wq = WAIT_QUEUE_INIT;
+static bcache_stat_t stats = { .blocks = BCACHE_BLOCKS };
+
+/*
+ * blk_register
+ *   DESCRIPTION: Adds a probed device to the registry
+ *   INPUTS: blk_dev_t* dev - device with name, sectors and start set
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the registry is full
+ */
+int32_t
+blk_register(blk_dev_t* dev)
+{
+	blk_queue_t* q = &dev->queue;
+	uint32_t i;
+
+	if (num_blk_devs == MAX_BLK_DEVS)
+		return -1;
+
+	memset(q, 0, sizeof(*q));
+	q->elv = &DEFAULT_ELEVATOR;
+	strncpy(q->stats.sched, (int8_t*)q->elv->name, IOSCHED_NAME_LEN - 1);
+	for (i = 0; i < BLK_MAX_REQS; i++) {
+		q->reqs[i].next = q->free;
+		q->free = &q->reqs[i];
+	}
+	q->nr_free = BLK_MAX_REQS;
+
+	blk_devs[num_blk_devs++] = dev;
+	printf("%s: %d sectors, %s scheduler\n", dev->name, dev->sectors, q->elv->name);
+	return 0;
+}
+
+/* Registered device by registration order, NULL past the last */
+blk_dev_t*
+blk_get(uint32_t index)
+{
+	return (index < num_blk_devs) ? blk_devs[index] : NULL;
+}
+
+/* Finish the transfer of one buffer of a completed request */
+static void
+end_bh_io(buf_head_t* bh, uint32_t dir, int32_t error)
+{
+	uint32_t flags;
+
+	spin_lock_irqsave(&bcache_lock, flags);
+	if (!error) {
+		if (dir == BLK_READ)
+			bh->state |= BH_VALID;
+		else
+			bh->state &= ~BH_DIRTY;
+	}
+	bh->io_done = 1;
+	spin_unlock_irqrestore(&bcache_lock, flags);
+
+	brelse(bh);
+}
+
+/* Record the latency of a finished request, finish its buffers and free
+ * it, caller holds the queue lock */
+static void
+blk_end(blk_queue_t* q, blk_req_t* req, int32_t error)
+{
+	uint32_t i, latency, bucket;
+
+	latency = (rdtsc() - req->submitted) >> IO_HIST_SHIFT;
+	for (bucket = 0; latency > 1 && bucket < IO_HIST_BUCKETS - 1; bucket++)
+		latency >>= 1;
+	q->stats.hist[bucket]++;
+
+	for (i = 0; i < req->nsegs; i++)
+		end_bh_io(req->bh[i], req->dir, error);
+
+	req->next = q->free;
+	q->free = req;
+	q->nr_free++;
+}
+
+/* Start the next queued request if the device is idle, caller holds the
+ * queue lock with interrupts disabled. Requests the device refuses fail
+ * and the next one is tried. Returns the number that failed. */
+static uint32_t
+blk_dispatch(blk_dev_t* dev)
+{
+	blk_queue_t* q = &dev->queue;
+	blk_req_t* req;
+	uint32_t failed = 0;
+
+	while (q->active == NULL && (req = q->elv->next(q)) != NULL) {
+		q->active = req;
+		q->next_sector = req->sector + req->count;
+		q->stats.dispatched++;
+		q->stats.sectors += req->count;
+		if (dev->start(dev, req) == 0)
+			break;
+
+		q->active = NULL;
+		blk_end(q, req, 1);
+		failed++;
+	}
+
+	return failed;
+}
+
+/*
+ * submit_bh
+ *   DESCRIPTION: Queues the transfer of a buffer whose io_done the caller
+ *                cleared. The block is merged into a queued request when
+ *                the scheduler finds an adjacent one. The request holds a
+ *                reference on the buffer until it completes.
+ *   INPUTS: buf_head_t* bh - held buffer
+ *           uint32_t dir - BLK_READ or BLK_WRITE
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: sleeps while every request of the device is in use
+ */
+static void
+submit_bh(buf_head_t* bh, uint32_t dir)
+{
+	blk_dev_t* dev = bh->dev;
+	blk_queue_t* q = &dev->queue;
+	blk_req_t* req;
+	uint32_t flags, failed;
+
+	spin_lock_irqsave(&bcache_lock, flags);
+	bh->refcount++;
+	spin_unlock_irqrestore(&bcache_lock, flags);
+
+	while (1) {
+		spin_lock_irqsave(&q->lock, flags);
+		if (q->elv->merge(q, bh, dir)) {
+			q->stats.merged++;
+			spin_unlock_irqrestore(&q->lock, flags);
+			return;
+		}
+		if ((req = q->free) != NULL)
+			break;
+		spin_unlock_irqrestore(&q->lock, flags);
+		wait_event(&q->wq, &q->nr_free);
+	}
+
+	q->free = req->next;
+	q->nr_free--;
+	req->sector = bh->block * SECTORS_PER_BLK;
+	req->count = SECTORS_PER_BLK;
+	req->dir = dir;
+	req->nsegs = 1;
+	req->bh[0] = bh;
+	req->submitted = rdtsc();
+	q->elv->add(q, req);
+	q->stats.queued++;
+
+	failed = blk_dispatch(dev);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	/* Failed requests went back to the free list */
+	if (failed)
+		wake_up(&q->wq);
+}
+
+/*
+ * blk_complete
+ *   DESCRIPTION: Called by a driver when the device's active request ends.
+ *                Records its latency, finishes its buffers and starts the
+ *                next request.
+ *   INPUTS: blk_dev_t* dev - device
+ *           int32_t error - nonzero if the transfer failed
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+blk_complete(blk_dev_t* dev, int32_t error)
+{
+	blk_queue_t* q = &dev->queue;
+	blk_req_t* req;
+	uint32_t flags;
+
+	spin_lock_irqsave(&q->lock, flags);
+	req = q->active;
+	q->active = NULL;
+	if (req == NULL) {
+		spin_unlock_irqrestore(&q->lock, flags);
+		return;
+	}
+
+	blk_end(q, req, error);
+	blk_dispatch(dev);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	wake_up(&q->wq);
+}
+
+/* Unlink a buffer from the use list, caller holds bcache_lock */
+static void
+lru_remove(buf_head_t* bh)
+{
+	if (bh->lru_prev != NULL)
+		bh->lru_prev->lru_next = bh->lru_next;
+	else
+		lru_head = bh->lru_next;
+	if (bh->lru_next != NULL)
+		bh->lru_next->lru_prev = bh->lru_prev;
+	else
+		lru_tail = bh->lru_prev;
+}
+
+/* Make a buffer the most recently used, caller holds bcache_lock */
+static void
+lru_touch(buf_head_t* bh)
+{
+	if (bh == lru_tail)
+		return;
+
+	lru_remove(bh);
+	bh->lru_prev = lru_tail;
+	bh->lru_next = NULL;
+	lru_tail->lru_next = bh;
+	lru_tail = bh;
+}
+
+/* Remove a buffer from its hash chain, caller holds bcache_lock */
+static void
+hash_remove(buf_head_t* bh)
+{
+	buf_head_t** link = &hash_table[bcache_hash(bh->dev, bh->block)];
+
+	while (*link != NULL && *link != bh)
+		link = &(*link)->hash_next;
+	if (*link != NULL)
+		*link = bh->hash_next;
+	bh->hash_next = NULL;
+}
+
+/*
+ * bcache_init
+ *   DESCRIPTION: Puts every buffer on the use list, none of them hashed
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+bcache_init(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < BCACHE_BLOCKS; i++) {
+		buffers[i].data = buf_data[i];
+		buffers[i].io_done = 1;
+		buffers[i].lru_prev = (i == 0) ? NULL : &buffers[i - 1];
+		buffers[i].lru_next = (i == BCACHE_BLOCKS - 1) ? NULL : &buffers[i + 1];
+	}
+	lru_head = &buffers[0];
+	lru_tail = &buffers[BCACHE_BLOCKS - 1];
+}
+
+/*
+ * getblk
+ *   DESCRIPTION: Finds the buffer caching a block, or takes over the least
+ *                recently used unheld buffer for it. A dirty victim is
+ *                written back first.
+ *   INPUTS: blk_dev_t* dev - device
+ *           uint32_t block - block number
+ *   OUTPUTS: none
+ *   RETURN VALUE: held buffer, not necessarily BH_VALID yet
+ *   SIDE EFFECTS: sleeps while every buffer is held
+ */
+static buf_head_t*
+getblk(blk_dev_t* dev, uint32_t block)
+{
+	buf_head_t* bh;
+	uint32_t flags;
+
+	while (1) {
+		spin_lock_irqsave(&bcache_lock, flags);
+		for (bh = hash_table[bcache_hash(dev, block)]; bh != NULL; bh = bh->hash_next) {
+			if (bh->dev == dev && bh->block == block)
+				break;
+		}
+
+		if (bh != NULL) {
+			/* Cached, possibly still being read by another holder */
+			if (bh->refcount++ == 0)
+				nr_unheld--;
+			lru_touch(bh);
+			spin_unlock_irqrestore(&bcache_lock, flags);
+			return bh;
+		}
+
+		for (bh = lru_head; bh != NULL; bh = bh->lru_next) {
+			if (bh->refcount == 0)
+				break;
+		}
+		if (bh == NULL) {
+			spin_unlock_irqrestore(&bcache_lock, flags);
+			wait_event(&bcache_wq, &nr_unheld);
+			continue;
+		}
+
+		bh->refcount = 1;
+		nr_unheld--;
+		lru_touch(bh);
+
+		if (bh->state & BH_DIRTY) {
+			/* Clean the victim, then look again */
+			spin_unlock_irqrestore(&bcache_lock, flags);
+			bwrite(bh);
+			brelse(bh);
+			continue;
+		}
+
+		if (bh->dev != NULL) {
+			hash_remove(bh);
+			if (bh->state & BH_VALID)
+				stats.evictions++;
+		}
+		bh->dev = dev;
+		bh->block = block;
+		bh->state = 0;
+		bh->hash_next = hash_table[bcache_hash(dev, block)];
+		hash_table[bcache_hash(dev, block)] = bh;
+		spin_unlock_irqrestore(&bcache_lock, flags);
+		return bh;
+	}
+}
+
+/*
+ * bfill
+ *   DESCRIPTION: Makes a held buffer valid. Waits out a transfer already
+ *                reading it, otherwise queues a read. Read-ahead does not
+ *                wait for its read.
+ *   INPUTS: buf_head_t* bh - held buffer
+ *           uint32_t ahead - read for read-ahead rather than a reader
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success or once read-ahead is queued, -1 on a
+ *                 device error
+ */
+static int32_t
+bfill(buf_head_t* bh, uint32_t ahead)
+{
+	uint32_t flags;
+
+	while (1) {
+		spin_lock_irqsave(&bcache_lock, flags);
+		if (bh->state & BH_VALID) {
+			if (!ahead) {
+				stats.hits++;
+				if (bh->state & BH_READAHEAD)
+					stats.ra_hits++;
+				bh->state &= ~BH_READAHEAD;
+			}
+			spin_unlock_irqrestore(&bcache_lock, flags);
+			return 0;
+		}
+		if (bh->io_done) {
+			bh->io_done = 0;
+			if (ahead) {
+				stats.readahead++;
+				bh->state |= BH_READAHEAD;
+			} else {
+				stats.misses++;
+			}
+			spin_unlock_irqrestore(&bcache_lock, flags);
+			break;
+		}
+		spin_unlock_irqrestore(&bcache_lock, flags);
+
+		/* Another holder's read is in flight */
+		if (ahead)
+			return 0;
+		wait_event(&bcache_wq, &bh->io_done);
+	}
+
+	submit_bh(bh, BLK_READ);
+	if (ahead)
+		return 0;
+
+	wait_event(&bcache_wq, &bh->io_done);
+	return (bh->state & BH_VALID) ? 0 : -1;
+}
+
+/*
+ * bread
+ *   DESCRIPTION: Gets one BLK_SIZE block of a device from the cache,
+ *                reading it on a miss
+ *   INPUTS: blk_dev_t* dev - device to read
+ *           uint32_t block - block number
+ *   OUTPUTS: none
+ *   RETURN VALUE: held buffer, NULL on a bad block or device error
+ *   SIDE EFFECTS: sleeps for the transfer, and for a buffer if all are held
+ */
+buf_head_t*
+bread(blk_dev_t* dev, uint32_t block)
+{
+	buf_head_t* bh;
+
+	if (dev == NULL || block >= dev->sectors / SECTORS_PER_BLK)
+		return NULL;
+
+	bh = getblk(dev, block);
+	if (bfill(bh, 0) == -1) {
+		brelse(bh);
+		return NULL;
+	}
+
+	return bh;
+}
+
+/*
+ * breada
+ *   DESCRIPTION: Brings a block into the cache ahead of its first reader.
+ *                Nothing happens if it is cached already.
+ *   INPUTS: blk_dev_t* dev - device to read
+ *           uint32_t block - block number
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+breada(blk_dev_t* dev, uint32_t block)
+{
+	buf_head_t* bh;
+
+	if (dev == NULL || block >= dev->sectors / SECTORS_PER_BLK)
+		return;
+
+	bh = getblk(dev, block);
+	bfill(bh, 1);
+	brelse(bh);
+}
+
+/* Mark a held buffer modified, it is written back before reuse or by bsync */
+void
+bdirty(buf_head_t* bh)
+{
+	uint32_t flags;
+
+	spin_lock_irqsave(&bcache_lock, flags);
+	bh->state |= BH_DIRTY | BH_VALID;
+	spin_unlock_irqrestore(&bcache_lock, flags);
+}
+
+/*
+ * bwrite
+ *   DESCRIPTION: Writes a held buffer back to its block and waits for it
+ *   INPUTS: buf_head_t* bh - held buffer
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a device error (the buffer stays dirty)
+ */
+int32_t
+bwrite(buf_head_t* bh)
+{
+	uint32_t flags;
+
+	while (1) {
+		spin_lock_irqsave(&bcache_lock, flags);
+		if (bh->io_done) {
+			bh->io_done = 0;
+			stats.writebacks++;
+			spin_unlock_irqrestore(&bcache_lock, flags);
+			break;
+		}
+		spin_unlock_irqrestore(&bcache_lock, flags);
+		wait_event(&bcache_wq, &bh->io_done);
+	}
+
+	submit_bh(bh, BLK_WRITE);
+	wait_event(&bcache_wq, &bh->io_done);
+
+	return (bh->state & BH_DIRTY) ? -1 : 0;
+}
+
+/* Drop a buffer returned by bread, waking a reader waiting for one */
+void
+brelse(buf_head_t* bh)
+{
+	uint32_t flags;
+
+	if (bh == NULL)
+		return;
+
+	spin_lock_irqsave(&bcache_lock, flags);
+	if (--bh->refcount == 0)
+		nr_unheld++;
+	spin_unlock_irqrestore(&bcache_lock, flags);
+
+	wake_up(&bcache_wq);
+}
+
+/*
+ * bsync
+ *   DESCRIPTION: Writes back every dirty buffer
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+bsync(void)
+{
+	buf_head_t* bh;
+	uint32_t flags, i;
+
+	for (i = 0; i < BCACHE_BLOCKS; i++) {
+		bh = &buffers[i];
+		spin_lock_irqsave(&bcache_lock, flags);
+		if (!(bh->state & BH_DIRTY)) {
+			spin_unlock_irqrestore(&bcache_lock, flags);
+			continue;
+		}
+		if (bh->refcount++ == 0)
+			nr_unheld--;
+		spin_unlock_irqrestore(&bcache_lock, flags);
+
+		bwrite(bh);
+		brelse(bh);
+	}
+}
+
+/*
+ * syscall_bcachestat
+ *   DESCRIPTION: Copies the buffer cache counters to user space
+ *   INPUTS: bcache_stat_t* buf - structure to fill
+ *   OUTPUTS: the counters
+ *   RETURN VALUE: 0 on success, -1 on a bad buffer
+ */
+int32_t
+syscall_bcachestat(bcache_stat_t* buf)
+{
+	if (buf == NULL)
+		return -1;
+
+	memcpy(buf, &stats, sizeof(stats));
+	return 0;
+}
+
+/* Drop the clean, unused cached blocks of a device */
+static void
+bcache_drop(blk_dev_t* dev)
+{
+	buf_head_t* bh;
+	uint32_t flags, i;
+
+	spin_lock_irqsave(&bcache_lock, flags);
+	for (i = 0; i < BCACHE_BLOCKS; i++) {
+		bh = &buffers[i];
+		if (bh->dev == dev && bh->refcount == 0 && !(bh->state & BH_DIRTY)) {
+			hash_remove(bh);
+			bh->dev = NULL;
+			bh->state = 0;
+		}
+	}
+	spin_unlock_irqrestore(&bcache_lock, flags);
+}
+
+/*
+ * syscall_iosched
+ *   DESCRIPTION: Switches a device to another I/O scheduler. Queued
+ *                requests move to the new one; the counters restart and
+ *                the device's clean cached blocks are dropped so the new
+ *                scheduler is measured from a cold cache.
+ *   INPUTS: int32_t dev - device index
+ *           const uint8_t* name - "noop" or "deadline"
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a bad device or name
+ */
+int32_t
+syscall_iosched(int32_t dev, const uint8_t* name)
+{
+	blk_dev_t* d = blk_get(dev);
+	blk_queue_t* q;
+	elevator_t* elv;
+	blk_req_t* queued = NULL;
+	blk_req_t* req;
+	uint32_t flags;
+
+	if (d == NULL || name == NULL || (elv = elevator_find((int8_t*)name)) == NULL)
+		return -1;
+
+	q = &d->queue;
+	spin_lock_irqsave(&q->lock, flags);
+	while ((req = q->elv->next(q)) != NULL) {
+		req->fifo_next = queued;
+		queued = req;
+	}
+	q->elv = elv;
+	while ((req = queued) != NULL) {
+		queued = req->fifo_next;
+		elv->add(q, req);
+	}
+	memset(&q->stats, 0, sizeof(q->stats));
+	strncpy(q->stats.sched, (int8_t*)elv->name, IOSCHED_NAME_LEN - 1);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	bcache_drop(d);
+	return 0;
+}
+
+/*
+ * syscall_iostat
+ *   DESCRIPTION: Copies a device's request queue counters to user space
+ *   INPUTS: int32_t dev - device index
+ *           io_stat_t* buf - structure to fill
+ *   OUTPUTS: the counters and latency histogram
+ *   RETURN VALUE: 0 on success, -1 on a bad device or buffer
+ */
+int32_t
+syscall_iostat(int32_t dev, io_stat_t* buf)
+{
+	blk_dev_t* d = blk_get(dev);
+
+	if (d == NULL || buf == NULL)
+		return -1;
+
+	memcpy(buf, &d->queue.stats, sizeof(*buf));
+	return 0;
+}
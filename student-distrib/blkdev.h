@@ -0,0 +1,164 @@
+/* blkdev.h - Generic block devices and the buffer cache filesystems read
+ * them through
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _BLKDEV_H
+#define _BLKDEV_H
+
+#include "types.h"
+#include "sched.h"
+
+#define SECTOR_SIZE		512			// Unit of device transfers
+#define BLK_SIZE		4096		// Unit of bread, one filesystem block
+#define SECTORS_PER_BLK	(BLK_SIZE / SECTOR_SIZE)
+#define MAX_BLK_DEVS	4
+#define BCACHE_BLOCKS	256			// Blocks cached, 1MB
+#define BCACHE_HASH		64			// Hash chains, a power of two
+
+#define BLK_MAX_SEGS	16			// Blocks merged into one request
+#define BLK_MAX_REQS	32			// Requests queued on one device
+
+/* Transfer directions */
+#define BLK_READ	0
+#define BLK_WRITE	1
+#define BLK_DIRS	2
+
+/* Request latency histogram: bucket i counts latencies below
+ * 2^(i + IO_HIST_SHIFT + 1) TSC cycles, the last one everything longer */
+#define IO_HIST_BUCKETS	16
+#define IO_HIST_SHIFT	14
+#define IOSCHED_NAME_LEN 16
+
+struct buf_head_t;
+struct blk_queue_t;
+
+/* Transfer of adjacent blocks in one direction, built by merging buffers */
+typedef struct blk_req_t {
+	uint32_t sector;
+	uint32_t count;			// Sectors
+	uint32_t dir;
+	uint32_t nsegs;
+	struct buf_head_t* bh[BLK_MAX_SEGS];	// In sector order
+	uint32_t submitted;		// rdtsc() when queued
+	uint32_t deadline;		// rdtsc() by which a deadline scheduler dispatches it
+
+	/* Scheduler lists */
+	struct blk_req_t* next;
+	struct blk_req_t* prev;
+	struct blk_req_t* fifo_next;
+	struct blk_req_t* fifo_prev;
+} blk_req_t;
+
+/* I/O scheduler: decides which queued request the device gets next */
+typedef struct elevator_t {
+	const char* name;
+	/* Add a block to a queued request, 1 if it found one */
+	int32_t (*merge)(struct blk_queue_t* q, struct buf_head_t* bh, uint32_t dir);
+	/* Queue a new request */
+	void (*add)(struct blk_queue_t* q, blk_req_t* req);
+	/* Remove the request to dispatch, NULL when none are queued */
+	blk_req_t* (*next)(struct blk_queue_t* q);
+} elevator_t;
+
+/* Request queue counters, copied out by SYS_IOSTAT */
+typedef struct io_stat_t {
+	int8_t sched[IOSCHED_NAME_LEN];
+	uint32_t queued;		// Requests created
+	uint32_t merged;		// Blocks added to a queued request
+	uint32_t dispatched;
+	uint32_t expired;		// Dispatched early because their deadline passed
+	uint32_t sectors;
+	uint32_t hist[IO_HIST_BUCKETS];	// Submission to completion latency
+} io_stat_t;
+
+/* Requests of one device waiting for it, ordered by its scheduler */
+typedef struct blk_queue_t {
+	spinlock_t lock;
+	elevator_t* elv;
+	blk_req_t* head;		// Scheduler order
+	blk_req_t* tail;
+	blk_req_t* fifo_head[BLK_DIRS];	// Arrival order, deadline only
+	blk_req_t* fifo_tail[BLK_DIRS];
+	uint32_t next_sector;	// Just past the last dispatched request
+	blk_req_t* active;		// Running on the device
+
+	blk_req_t reqs[BLK_MAX_REQS];
+	blk_req_t* free;
+	volatile uint32_t nr_free;
+	wait_queue_t wq;		// Waiting for a free request
+	io_stat_t stats;
+} blk_queue_t;
+
+/* A disk registered by its driver */
+typedef struct blk_dev_t {
+	const char* name;
+	uint32_t sectors;		// Capacity
+	/* Start a request on the device, called with interrupts disabled. The
+	 * driver calls blk_complete when it finishes; -1 means the device
+	 * never took it, and the request fails at once. */
+	int32_t (*start)(struct blk_dev_t* dev, blk_req_t* req);
+	void* priv;				// Driver data
+	blk_queue_t queue;
+} blk_dev_t;
+
+/* Buffer state bits */
+#define BH_VALID		0x1			// Data was read from (or is newer than) the disk
+#define BH_DIRTY		0x2			// Must be written back before reuse
+#define BH_READAHEAD	0x4			// Read ahead and not used since
+
+/* One cached block of a device. Unheld buffers are reused least recently
+ * used first. */
+typedef struct buf_head_t {
+	blk_dev_t* dev;
+	uint32_t block;
+	uint32_t refcount;
+	uint32_t state;			// BH_* bits
+	volatile uint32_t io_done;	// No transfer in flight
+	uint8_t* data;			// BLK_SIZE bytes
+	struct buf_head_t* hash_next;
+	struct buf_head_t* lru_prev;
+	struct buf_head_t* lru_next;
+} buf_head_t;
+
+/* Buffer cache counters, copied out by SYS_BCACHESTAT */
+typedef struct bcache_stat_t {
+	uint32_t blocks;		// Cache size
+	uint32_t hits;
+	uint32_t misses;		// Blocks read because a reader needed them
+	uint32_t readahead;		// Blocks read ahead of the readers
+	uint32_t ra_hits;		// Read-ahead blocks later used
+	uint32_t evictions;		// Cached blocks dropped for others
+	uint32_t writebacks;
+} bcache_stat_t;
+
+/* Make a device visible to blk_get */
+int32_t blk_register(blk_dev_t* dev);
+/* Registered device by registration order, NULL past the last */
+blk_dev_t* blk_get(uint32_t index);
+
+/* Report the end of a device's active request, from its interrupt handler */
+void blk_complete(blk_dev_t* dev, int32_t error);
+/* Switch a device's I/O scheduler, clearing its counters */
+int32_t syscall_iosched(int32_t dev, const uint8_t* name);
+/* Copy a device's request queue counters to a user buffer */
+int32_t syscall_iostat(int32_t dev, io_stat_t* buf);
+
+/* Set up the buffer cache's free list */
+void bcache_init(void);
+/* Get a block from the cache, reading it on a miss */
+buf_head_t* bread(blk_dev_t* dev, uint32_t block);
+/* Start caching a block nobody needs yet */
+void breada(blk_dev_t* dev, uint32_t block);
+/* Mark a held buffer modified */
+void bdirty(buf_head_t* bh);
+/* Write a buffer's block back to its device */
+int32_t bwrite(buf_head_t* bh);
+/* Drop a buffer returned by bread */
+void brelse(buf_head_t* bh);
+/* Write back every dirty buffer */
+void bsync(void);
+/* Copy the cache counters to a user buffer */
+int32_t syscall_bcachestat(bcache_stat_t* buf);
+
+#endif /* _BLKDEV_H */
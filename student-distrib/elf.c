@@ -0,0 +1,282 @@
+/* elf.c - ELF32 program loading. Execute only checks the headers and
+ * records the PT_LOAD segments; every page of the program region is
+ * mapped on its first fault. File pages come from a per-program cache
+ * shared by all processes running it, text read-only and data
+ * copy-on-write. Private pages (written data, BSS, stack) use the frame at
+ * the same offset in the process's own 4MB slot.
+ * vim:ts=4 noexpandtab
+ */
+
+#include "elf.h"
+#include "page_init.h"
+#include "syscall.h"
+
+static image_t images[MAX_IMAGES];
+static spinlock_t image_lock = SPIN_LOCK_UNLOCKED;
+
+/*
+ * image_get
+ *   DESCRIPTION: Finds the page cache of a program, taking over the slot of
+ *                a program nobody runs any more if it is not cached yet
+ *   INPUTS: uint32_t inode - inode of the program file
+ *   OUTPUTS: none
+ *   RETURN VALUE: referenced cache, or NULL if every slot is in use
+ */
+static image_t*
+image_get(uint32_t inode)
+{
+	image_t* img = NULL;
+	uint32_t i, flags;
+
+	spin_lock_irqsave(&image_lock, flags);
+	for (i = 0; i < MAX_IMAGES; i++) {
+		if (images[i].used && images[i].inode_num == inode) {
+			img = &images[i];
+			break;
+		}
+		if (images[i].refcount == 0 && (img == NULL || img->used))
+			img = &images[i];
+	}
+
+	if (img != NULL && !(img->used && img->inode_num == inode)) {
+		/* Evict an unused program */
+		for (i = 0; i < IMAGE_MAX_PAGES; i++) {
+			if (img->frame[i] != 0)
+				free_frame(img->frame[i]);
+			img->frame[i] = 0;
+		}
+		img->used = 1;
+		img->inode_num = inode;
+	}
+
+	if (img != NULL)
+		img->refcount++;
+	spin_unlock_irqrestore(&image_lock, flags);
+
+	return img;
+}
+
+/* Drop a reference, the cached pages stay for the next execute */
+static void
+image_put(image_t* img)
+{
+	uint32_t flags;
+
+	spin_lock_irqsave(&image_lock, flags);
+	img->refcount--;
+	spin_unlock_irqrestore(&image_lock, flags);
+}
+
+/* Copy the file bytes of a segment that fall in page into kpage, the
+ * kernel's view of the frame behind it */
+static void
+fill_from_file(pcb_t* proc, elf_seg_t* seg, uint32_t page, uint8_t* kpage)
+{
+	uint32_t start = (page > seg->vaddr) ? page : seg->vaddr;
+	uint32_t end = seg->vaddr + seg->filesz;
+
+	if (end > page + PAGE_ALIGN)
+		end = page + PAGE_ALIGN;
+	if (start < end)
+		read_data(proc->exe_inode, seg->offset + (start - seg->vaddr), kpage + (start - page), end - start);
+}
+
+/*
+ * image_page
+ *   DESCRIPTION: Returns the cached frame holding the file page behind a
+ *                segment page, reading it in on first use. A page holding
+ *                BSS bytes cannot be shared.
+ *   INPUTS: pcb_t* proc - faulting process
+ *           elf_seg_t* seg - only segment covering page
+ *           uint32_t page - page-aligned faulting address
+ *   OUTPUTS: none
+ *   RETURN VALUE: physical frame, 0 if the page must be private
+ */
+static uint32_t
+image_page(pcb_t* proc, elf_seg_t* seg, uint32_t page)
+{
+	image_t* img = proc->image;
+	uint32_t file_off, fpage, len, flen, flags;
+	uint32_t frame;
+
+	if (img == NULL || ((seg->vaddr ^ seg->offset) & ~PAGE_MASK))
+		return 0;
+	if (seg->memsz != seg->filesz && page + PAGE_ALIGN > seg->vaddr + seg->filesz)
+		return 0;
+
+	/* Offsets are congruent, so this is the start of a file page */
+	file_off = seg->offset + page - seg->vaddr;
+	fpage = file_off >> PT_SHIFT;
+	if (fpage >= IMAGE_MAX_PAGES)
+		return 0;
+
+	spin_lock_irqsave(&image_lock, flags);
+	frame = img->frame[fpage];
+	spin_unlock_irqrestore(&image_lock, flags);
+	if (frame != 0 || (frame = alloc_frame()) == 0)
+		return frame;
+
+	/* Read the whole file page through the kernel's view of the frame. The
+	 * read may sleep on the disk, so it runs unlocked and the first reader
+	 * wins. */
+	memset(phys_to_virt(frame), 0, PAGE_ALIGN);
+	flen = read_file_length(proc->exe_inode);
+	len = (flen - file_off < PAGE_ALIGN) ? flen - file_off : PAGE_ALIGN;
+	read_data(proc->exe_inode, file_off, (uint8_t*)phys_to_virt(frame), len);
+
+	spin_lock_irqsave(&image_lock, flags);
+	if (img->frame[fpage] == 0) {
+		img->frame[fpage] = frame;
+	} else {
+		free_frame(frame);
+		frame = img->frame[fpage];
+	}
+	spin_unlock_irqrestore(&image_lock, flags);
+
+	return frame;
+}
+
+/*
+ * elf_load
+ *   DESCRIPTION: Validates the ELF header and PT_LOAD program headers of a
+ *                program and records the segments. Nothing is read into
+ *                memory yet; pages are brought in by elf_fault.
+ *   INPUTS: pcb_t* proc - new process, its program region unmapped
+ *           uint32_t inode - inode of the program file
+ *   OUTPUTS: uint32_t* entry - entry point
+ *   RETURN VALUE: 0 on success, -1 if the file is not a loadable ELF32
+ *                 executable for the program region
+ */
+int32_t
+elf_load(pcb_t* proc, uint32_t inode, uint32_t* entry)
+{
+	elf32_ehdr_t eh;
+	elf32_phdr_t ph;
+	uint32_t flen = read_file_length(inode);
+	uint32_t i;
+
+	if (flen < sizeof(eh) || read_data(inode, 0, (uint8_t*)&eh, sizeof(eh)) != sizeof(eh))
+		return -1;
+
+	if (eh.e_ident[0] != INITIAL_BYTE || eh.e_ident[1] != E || eh.e_ident[2] != L || eh.e_ident[3] != F)
+		return -1;
+	if (eh.e_ident[EI_CLASS] != ELFCLASS32 || eh.e_type != ET_EXEC || eh.e_machine != EM_386)
+		return -1;
+	if (eh.e_phentsize != sizeof(ph) || eh.e_phoff > flen || eh.e_phnum > (flen - eh.e_phoff) / sizeof(ph))
+		return -1;
+
+	proc->nsegs = 0;
+	for (i = 0; i < eh.e_phnum; i++) {
+		read_data(inode, eh.e_phoff + i * sizeof(ph), (uint8_t*)&ph, sizeof(ph));
+		if (ph.p_type != PT_LOAD)
+			continue;
+
+		/* Segment must fit below the user stack and within the file */
+		if (proc->nsegs == MAX_SEGMENTS || ph.p_filesz > ph.p_memsz)
+			return -1;
+		if (ph.p_vaddr < PROG_VIRT_ADDR || ph.p_vaddr >= USER_STACK || ph.p_memsz > USER_STACK - ph.p_vaddr)
+			return -1;
+		if (ph.p_offset > flen || ph.p_filesz > flen - ph.p_offset)
+			return -1;
+
+		proc->seg[proc->nsegs].vaddr = ph.p_vaddr;
+		proc->seg[proc->nsegs].memsz = ph.p_memsz;
+		proc->seg[proc->nsegs].filesz = ph.p_filesz;
+		proc->seg[proc->nsegs].offset = ph.p_offset;
+		proc->seg[proc->nsegs].flags = ph.p_flags;
+		proc->nsegs++;
+	}
+
+	if (proc->nsegs == 0 || eh.e_entry < PROG_VIRT_ADDR || eh.e_entry >= USER_STACK)
+		return -1;
+
+	proc->exe_inode = inode;
+	proc->image = image_get(inode);
+	*entry = eh.e_entry;
+
+	return 0;
+}
+
+/*
+ * elf_release
+ *   DESCRIPTION: Unmaps the whole program region of a halting process and
+ *                drops its reference on the program's page cache
+ *   INPUTS: pcb_t* proc - halting process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+elf_release(pcb_t* proc)
+{
+	memset(prog_table[proc->pid], 0, sizeof(prog_table[proc->pid]));
+
+	if (proc->image != NULL)
+		image_put(proc->image);
+	proc->image = NULL;
+	proc->nsegs = 0;
+}
+
+/*
+ * elf_fault
+ *   DESCRIPTION: Page fault handler for the program region. A not-present
+ *                page covered by one segment is mapped from the page cache
+ *                (read-only; writable segments copy on the first write).
+ *                Other pages get the slot's private frame, zeroed and
+ *                filled with the file bytes of the segments covering it.
+ *   INPUTS: uint32_t fault_addr - faulting linear address from CR2
+ *           uint32_t error_code - error code pushed by the processor
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the access can be retried, -1 otherwise
+ */
+int32_t
+elf_fault(uint32_t fault_addr, uint32_t error_code)
+{
+	pcb_t* proc = current_pcb;
+	uint32_t page = fault_addr & PAGE_MASK;
+	elf_seg_t* seg = NULL;
+	uint32_t covered = 0, writable = 0;
+	uint32_t home, frame, i;
+	uint32_t* pte;
+
+	if (proc == NULL || fault_addr < PROG_VIRT_ADDR || fault_addr >= PROG_VIRT_ADDR + PROCESS_PAGE_SIZE)
+		return -1;
+
+	pte = (uint32_t*)&prog_table[proc->pid][(page >> PT_SHIFT) & PT_INDEX_MASK];
+	home = PROCESS_PHYS_ADDR(proc->pid) + (page - PROG_VIRT_ADDR);
+
+	for (i = 0; i < proc->nsegs; i++) {
+		if (page < proc->seg[i].vaddr + proc->seg[i].memsz && page + PAGE_ALIGN > proc->seg[i].vaddr) {
+			seg = &proc->seg[i];
+			covered++;
+			writable |= seg->flags & PF_W;
+		}
+	}
+
+	if (error_code & PF_PRESENT_ERR) {
+		/* Only the first write to a shared data page can be fixed up */
+		if (!(error_code & PF_WRITE_ERR) || !writable || (*pte & RW_FLAG))
+			return -1;
+
+		memcpy(phys_to_virt(home), phys_to_virt(*pte & PAGE_MASK), PAGE_ALIGN);
+		*pte = home | US_FLAG | RW_FLAG | P_FLAG;
+		invlpg(page);
+		return 0;
+	}
+
+	if (covered == 1 && (frame = image_page(proc, seg, page)) != 0) {
+		*pte = frame | US_FLAG | P_FLAG;
+		invlpg(page);
+		return 0;
+	}
+
+	/* Private page, filled through the kernel's view of the slot */
+	memset(phys_to_virt(home), 0, PAGE_ALIGN);
+	for (i = 0; i < proc->nsegs; i++)
+		fill_from_file(proc, &proc->seg[i], page, phys_to_virt(home));
+
+	/* Pages outside every segment are stack or scratch memory */
+	*pte = home | US_FLAG | P_FLAG | ((covered == 0 || writable) ? RW_FLAG : 0);
+	invlpg(page);
+
+	return 0;
+}
@@ -0,0 +1,82 @@
+/* elf.h - ELF32 program loading and demand paging of the program image
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _ELF_H
+#define _ELF_H
+
+#include "types.h"
+
+/* ELF header identification */
+#define EI_NIDENT	16
+#define EI_CLASS	4
+#define ELFCLASS32	1
+#define ET_EXEC		2
+#define EM_386		3
+
+/* Program header types and segment flags */
+#define PT_LOAD		1
+#define PF_X		0x1
+#define PF_W		0x2
+#define PF_R		0x4
+
+#define MAX_SEGMENTS	4		// PT_LOAD segments kept per process
+#define MAX_IMAGES		8		// Programs whose file pages are cached at once
+#define IMAGE_MAX_PAGES	64		// File pages cached per program, later pages are private
+
+typedef struct elf32_ehdr_t {
+	uint8_t e_ident[EI_NIDENT];
+	uint16_t e_type;
+	uint16_t e_machine;
+	uint32_t e_version;
+	uint32_t e_entry;
+	uint32_t e_phoff;
+	uint32_t e_shoff;
+	uint32_t e_flags;
+	uint16_t e_ehsize;
+	uint16_t e_phentsize;
+	uint16_t e_phnum;
+	uint16_t e_shentsize;
+	uint16_t e_shnum;
+	uint16_t e_shstrndx;
+} elf32_ehdr_t;
+
+typedef struct elf32_phdr_t {
+	uint32_t p_type;
+	uint32_t p_offset;
+	uint32_t p_vaddr;
+	uint32_t p_paddr;
+	uint32_t p_filesz;
+	uint32_t p_memsz;
+	uint32_t p_flags;
+	uint32_t p_align;
+} elf32_phdr_t;
+
+/* PT_LOAD segment of the running program, paged in on first touch */
+typedef struct elf_seg_t {
+	uint32_t vaddr;
+	uint32_t memsz;
+	uint32_t filesz;
+	uint32_t offset;
+	uint32_t flags;		// PF_* bits
+} elf_seg_t;
+
+/* File pages of one program shared by every process running it. Text is
+ * mapped read-only, data copy-on-write. */
+typedef struct image_t {
+	uint32_t used;
+	uint32_t inode_num;
+	uint32_t refcount;	// Processes running the program
+	uint32_t frame[IMAGE_MAX_PAGES];	// Physical frame of each file page, 0 until read
+} image_t;
+
+struct pcb_t;
+
+/* Check the ELF headers of a program and record its segments in proc */
+int32_t elf_load(struct pcb_t* proc, uint32_t inode, uint32_t* entry);
+/* Unmap the program image of a halting process */
+void elf_release(struct pcb_t* proc);
+/* Page in a program, BSS or stack page, or copy a data page on write */
+int32_t elf_fault(uint32_t fault_addr, uint32_t error_code);
+
+#endif /* _ELF_H */
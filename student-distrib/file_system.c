@@ -5,6 +5,9 @@
 #include "file_system.h"
 
 boot_block_t* fs_boot; // Globally shared pointer to file system
+boot_block_t* fs_module; // File system image loaded by the boot loader
+static boot_block_t disk_boot; // Copy of the boot block when mounted from disk
+static blk_dev_t* fs_dev; // Disk holding the file system, NULL for the module
 
 /*
 * int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry)
@@ -57,70 +60,187 @@ int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry) {
 	return 0;
 }
 
+/*
+* uint8_t* fs_get_block(uint32_t block, buf_head_t** bh)
+*	Inputs: uint32_t block = filesystem block number, 0 is the boot block
+*			buf_head_t** bh = set to the buffer to pass to fs_put_block
+*	Return Value: pointer to the block's BLOCK_SIZE bytes, NULL on a disk error
+*	Function: Reads a block from the mounted disk, or points into the boot
+*				module when there is none
+*/
+static uint8_t* fs_get_block(uint32_t block, buf_head_t** bh) {
+	if (fs_dev == NULL) {
+		*bh = NULL;
+		return (uint8_t*)fs_module + block * BLOCK_SIZE;
+	}
+	
+	*bh = bread(fs_dev, block);
+	return (*bh == NULL) ? NULL : (*bh)->data;
+}
+
+/*
+* void fs_put_block(buf_head_t* bh)
+*	Inputs: buf_head_t* bh = buffer set by fs_get_block
+*	Return Value: none
+*	Function: Releases a block returned by fs_get_block
+*/
+static void fs_put_block(buf_head_t* bh) {
+	if (bh != NULL)
+		brelse(bh);
+}
+
+/*
+* int32_t fs_mount(void)
+*	Inputs: none
+*	Return Value: 0 if a disk holds the file system, -1 to keep the module
+*	Function: Looks for the createfs layout on each block device and
+*				switches every later read to the first one that has it
+*/
+int32_t fs_mount(void) {
+	blk_dev_t* dev;
+	buf_head_t* bh;
+	boot_block_t* boot;
+	uint32_t i, blocks;
+	
+	for (i = 0; (dev = blk_get(i)) != NULL; i++) {
+		if ((bh = bread(dev, 0)) == NULL)
+			continue;
+		
+		/* Boot block counts must describe blocks the disk actually has */
+		boot = (boot_block_t*)bh->data;
+		blocks = dev->sectors / SECTORS_PER_BLK;
+		if (boot->d_entries == 0 || boot->d_entries > MAX_DENTRIES || boot->inodes == 0 ||
+			boot->inodes >= blocks || boot->d_blocks > blocks - 1 - boot->inodes) {
+			brelse(bh);
+			continue;
+		}
+		
+		memcpy(&disk_boot, boot, sizeof(disk_boot));
+		brelse(bh);
+		fs_boot = &disk_boot;
+		fs_dev = dev;
+		printf("File system on %s: %d files, %d data blocks\n", dev->name, fs_boot->d_entries, fs_boot->d_blocks);
+		return 0;
+	}
+	
+	return -1;
+}
+
 /*
 * int32_t read_data(uint32_t inode, uint32_t offset, uint32_t* buf, uint32_t length)
 *	Inputs: uint32_t inode = inode number
 *			uint32_t offset = position within the file
 *			uint32_t* buf = buffer that holds the data read
 *			uint32_t length = number of bytes to read from file
-*	Return Value: -1 for bad data block number, 0 if end of file reached or
-*					N number of bytes read into buffer
-*	Function: Copy data from data blocks to buf
+*	Return Value: -1 for a bad inode, offset or data block number, 0 if end
+*					of file reached or N number of bytes read into buffer
+*	Function: Copy data from data blocks to buf, one block at a time
 */
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length) {
+	buf_head_t* inode_bh;
+	buf_head_t* data_bh;
+	inode_t* in;
+	uint8_t* data;
+	uint32_t pos, count, data_block;
+	uint32_t bytes_read = 0;
+	
 	/* Check for invalid inode */
-	if (inode > fs_boot->inodes)
+	if (inode >= fs_boot->inodes)
 		return -1;
 		
 	/* Check for non-existent buff */
 	if (buf == NULL)
 		return -1;
 	
-	/* Find address to the inode block */
-	uint32_t* inode_addr = (uint32_t*)((uint32_t)fs_boot + ((inode + 1) * BLOCK_SIZE));
-	uint32_t f_length = *inode_addr;
+	/* Find the inode block */
+	if ((in = (inode_t*)fs_get_block(inode + 1, &inode_bh)) == NULL)
+		return -1;
 	
 	/* Check if referencing out of bound position */
-	if (offset > f_length)
+	if (offset > in->length) {
+		fs_put_block(inode_bh);
 		return -1;
-		
-	uint32_t* data_base_addr = (uint32_t*)((uint32_t)fs_boot + BLOCK_SIZE + (fs_boot->inodes * BLOCK_SIZE));
-	
-	uint32_t data_block_index = *(inode_addr + (offset / BLOCK_SIZE) + 1);
-	
-	uint32_t* data_addr = (uint32_t*)((uint32_t)data_base_addr + (data_block_index * BLOCK_SIZE));
+	}
 	
-	uint32_t bytes_read = 0;
-	char* tracker;
+	/* Stop at end of file */
+	if (length > in->length - offset)
+		length = in->length - offset;
 	
 	while (bytes_read < length) {
-		/* Check for eof */
-		if (offset + bytes_read > f_length)
-			return 0;
-			
-		/* Check for end of block */
-		if (((offset + bytes_read) % BLOCK_SIZE) == 0) {
-			data_block_index = *(inode_addr + (((offset + bytes_read) / BLOCK_SIZE) + 1));
-			data_addr = (uint32_t*)((uint32_t)data_base_addr + (data_block_index * BLOCK_SIZE));
-		}
+		pos = offset + bytes_read;
 		
-		tracker = (char*)data_addr + ((offset + bytes_read) % BLOCK_SIZE);
-		buf[bytes_read] = *tracker; 
-		bytes_read++;
+		/* Copy up to the end of this data block */
+		count = BLOCK_SIZE - (pos % BLOCK_SIZE);
+		if (count > length - bytes_read)
+			count = length - bytes_read;
+		
+		data_block = in->data_blocks[pos / BLOCK_SIZE];
+		if (data_block >= fs_boot->d_blocks)
+			break;
+		if ((data = fs_get_block(1 + fs_boot->inodes + data_block, &data_bh)) == NULL)
+			break;
+		
+		memcpy(buf + bytes_read, data + (pos % BLOCK_SIZE), count);
+		fs_put_block(data_bh);
+		bytes_read += count;
 	}
+	
+	fs_put_block(inode_bh);
+	
+	/* Bad data block or disk error before anything was read */
+	if (bytes_read == 0 && length > 0)
+		return -1;
 	return bytes_read;
 }
 
+/*
+* void read_ahead(uint32_t inode, uint32_t offset, uint32_t nblocks)
+*	Inputs: uint32_t inode = inode number
+*			uint32_t offset = position the next read starts at
+*			uint32_t nblocks = number of file blocks to have cached
+*	Return Value: none
+*	Function: Brings the data blocks from offset on into the buffer cache,
+*				stopping at end of file; nothing to do for the module
+*/
+void read_ahead(uint32_t inode, uint32_t offset, uint32_t nblocks) {
+	buf_head_t* bh;
+	inode_t* in;
+	uint32_t i, first, last;
+	
+	if (fs_dev == NULL || nblocks == 0 || inode >= fs_boot->inodes)
+		return;
+	if ((in = (inode_t*)fs_get_block(inode + 1, &bh)) == NULL)
+		return;
+	
+	first = offset / BLOCK_SIZE;
+	last = (in->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if (last > first + nblocks)
+		last = first + nblocks;
+	
+	for (i = first; i < last; i++) {
+		if (in->data_blocks[i] < fs_boot->d_blocks)
+			breada(fs_dev, 1 + fs_boot->inodes + in->data_blocks[i]);
+	}
+	
+	fs_put_block(bh);
+}
+
 /*
 * uint32_t read_file_length(uint32_t inode)
 *	Inputs: uint32_t inode = inode number
-*	Return Value: file length
+*	Return Value: file length, 0 for a bad inode or a disk error
 *	Function: Obtain the file length of given inode number
 */
 uint32_t read_file_length(uint32_t inode) {
-	/* Find address to the inode block */
-	uint32_t* inode_addr = (uint32_t*)((uint32_t)fs_boot + ((inode + 1) * BLOCK_SIZE));
-	uint32_t f_length = *inode_addr;
+	buf_head_t* bh;
+	inode_t* in;
+	uint32_t f_length;
+	
+	if (inode >= fs_boot->inodes || (in = (inode_t*)fs_get_block(inode + 1, &bh)) == NULL)
+		return 0;
+	
+	f_length = in->length;
+	fs_put_block(bh);
 	return f_length;
 }
 
@@ -131,16 +251,29 @@ uint32_t read_file_length(uint32_t inode) {
 *			file_desc_t* file_desc = pointer to file descriptor block
 *	Return Value: -1 for bad data block number, 0 if end of file reached or
 *					N number of bytes read into buffer
-*	Function: Read and copy info from file to buf
+*	Function: Read and copy info from file to buf, then read ahead of
+*				a sequential reader
 */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes) {
-/*	dentry_t temp;
+	file_desc_t* file = get_file(fd);
+	int32_t bytes_read = read_data(file->inode_num, file->file_pos, buf, nbytes);
 	
-	read_dentry_by_name(fname, &temp);
-*/	//Remember to delete commented (if this setup works
-	int32_t bytes_read = read_data(current_pcb->file_array[fd].inode_num, current_pcb->file_array[fd].file_pos, buf, nbytes);
-	current_pcb->file_array[fd].file_pos += bytes_read;
-
+	if (bytes_read <= 0)
+		return bytes_read;
+	
+	/* A read continuing the last one widens the read-ahead window, any
+	 * other position turns read-ahead off until reads are sequential */
+	if (file->file_pos == file->ra_next) {
+		file->ra_window = (file->ra_window == 0) ? RA_MIN_BLOCKS : file->ra_window * 2;
+		if (file->ra_window > RA_MAX_BLOCKS)
+			file->ra_window = RA_MAX_BLOCKS;
+	} else {
+		file->ra_window = 0;
+	}
+	
+	file->file_pos += bytes_read;
+	file->ra_next = file->file_pos;
+	read_ahead(file->inode_num, file->file_pos, file->ra_window);
 
 	return bytes_read;
 }
@@ -155,6 +288,7 @@ int32_t file_read(int32_t fd, void* buf, int32_t nbytes) {
 *	Function: Fill in buf with file names
 */
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes) {
+	file_desc_t* dir = get_file(fd);
 	dentry_t temp;
 	
 	/* Check for empty entries */
@@ -162,18 +296,190 @@ int32_t dir_read(int32_t fd, void* buf, int32_t nbytes) {
 		return 0;
 	
 	/* Check for end of directory entries */
-	if (current_pcb->file_array[fd].file_pos >= fs_boot->d_entries)
+	if (dir->file_pos >= fs_boot->d_entries)
 		return 0;
 	
-	if (!read_dentry_by_index(current_pcb->file_array[fd].file_pos, &temp)) {
+	if (!read_dentry_by_index(dir->file_pos, &temp)) {
 		strncpy((int8_t*)buf, (int8_t*)temp.fname, nbytes);
-		current_pcb->file_array[fd].file_pos++;
+		dir->file_pos++;
 		return nbytes;
 	}
 		
 	return -1;
 }
 
+/*
+* int32_t syscall_getdents(int32_t fd, dirent_t* buf, int32_t nbytes)
+*	Inputs: int32_t fd = open directory
+*			dirent_t* buf = user buffer for the records
+*			int32_t nbytes = size of buf in bytes
+*	Return Value: bytes filled (a multiple of sizeof(dirent_t)), 0 at the
+*					end of the directory, -1 if fd is not a directory or buf
+*					cannot hold one record
+*	Function: Fills buf with as many directory entries as fit, from the
+*				directory position on, and moves the position past them
+*/
+int32_t syscall_getdents(int32_t fd, dirent_t* buf, int32_t nbytes) {
+	file_desc_t* dir;
+	dentry_t temp;
+	uint32_t n = 0;
+	
+	if (buf == NULL || nbytes < (int32_t)sizeof(dirent_t))
+		return -1;
+	
+	dir = get_file(fd);
+	if (dir == NULL || dir->ops != &dir_ops)
+		return -1;
+	
+	while (n < nbytes / sizeof(dirent_t) && dir->file_pos < fs_boot->d_entries) {
+		if (read_dentry_by_index(dir->file_pos, &temp))
+			break;
+		
+		buf[n].inode_num = temp.inode_num;
+		buf[n].f_type = temp.f_type;
+		buf[n].length = (temp.f_type == TYPE_FILE) ? read_file_length(temp.inode_num) : 0;
+		strncpy((int8_t*)buf[n].fname, (int8_t*)temp.fname, NAME_LEN);
+		buf[n].fname[NAME_LEN] = '\0';
+		
+		dir->file_pos++;
+		n++;
+	}
+	
+	return n * sizeof(dirent_t);
+}
+
+/*
+* void fill_stat(uint32_t type, uint32_t inode, stat_t* buf)
+*	Inputs: uint32_t type = TYPE_* of the file
+*			uint32_t inode = its inode number, used for regular files
+*			stat_t* buf = record to fill
+*	Return Value: none
+*	Function: Fills buf from the inode; only the length is read
+*/
+static void fill_stat(uint32_t type, uint32_t inode, stat_t* buf) {
+	buf->f_type = type;
+	buf->inode_num = (type == TYPE_FILE) ? inode : 0;
+	buf->length = (type == TYPE_FILE) ? read_file_length(inode) : 0;
+	buf->blocks = (buf->length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+/*
+* int32_t syscall_stat(const uint8_t* fname, stat_t* buf)
+*	Inputs: const uint8_t* fname = name of the file
+*			stat_t* buf = user record to fill
+*	Return Value: 0 on success, -1 if there is no such file
+*	Function: Type, inode, length and block count of a file, without
+*				opening or reading it
+*/
+int32_t syscall_stat(const uint8_t* fname, stat_t* buf) {
+	dentry_t temp;
+	
+	if (fname == NULL || buf == NULL || read_dentry_by_name(fname, &temp) == -1)
+		return -1;
+	
+	fill_stat(temp.f_type, temp.inode_num, buf);
+	return 0;
+}
+
+/*
+* int32_t syscall_fstat(int32_t fd, stat_t* buf)
+*	Inputs: int32_t fd = open file descriptor
+*			stat_t* buf = user record to fill
+*	Return Value: 0 on success, -1 for a descriptor that is not open
+*	Function: Same as stat for the file open on fd
+*/
+int32_t syscall_fstat(int32_t fd, stat_t* buf) {
+	file_desc_t* file;
+	uint32_t type;
+	
+	file = get_file(fd);
+	if (file == NULL || buf == NULL)
+		return -1;
+	
+	if (file->ops == &file_ops)
+		type = TYPE_FILE;
+	else if (file->ops == &dir_ops)
+		type = TYPE_DIR;
+	else if (file->ops == &rtc_ops)
+		type = TYPE_RTC;
+	else
+		type = TYPE_TERM;
+	
+	fill_stat(type, file->inode_num, buf);
+	return 0;
+}
+
+/*
+* int32_t syscall_lseek(int32_t fd, int32_t offset, int32_t whence)
+*	Inputs: int32_t fd = open file or directory
+*			int32_t offset = bytes (entries for the directory) to move
+*			int32_t whence = SEEK_SET, SEEK_CUR or SEEK_END
+*	Return Value: new position, -1 for a descriptor that cannot seek or a
+*					position before the start or past the end
+*	Function: Moves the position the next read starts at. Nothing is read,
+*				read_data finds the block of any offset directly.
+*/
+int32_t syscall_lseek(int32_t fd, int32_t offset, int32_t whence) {
+	file_desc_t* file;
+	uint32_t end, base;
+	
+	file = get_file(fd);
+	if (file == NULL)
+		return -1;
+	
+	if (file->ops == &file_ops)
+		end = read_file_length(file->inode_num);
+	else if (file->ops == &dir_ops)
+		end = fs_boot->d_entries;
+	else
+		return -1;
+	
+	switch (whence) {
+		case SEEK_SET:
+			base = 0;
+			break;
+		case SEEK_CUR:
+			base = file->file_pos;
+			break;
+		case SEEK_END:
+			base = end;
+			break;
+		default:
+			return -1;
+	}
+	
+	/* The file system is read-only, there is nothing past the end */
+	if ((offset < 0 && -offset > base) || base + offset > end)
+		return -1;
+	
+	file->file_pos = base + offset;
+	return file->file_pos;
+}
+
+/*
+* int32_t syscall_pread(int32_t fd, void* buf, int32_t nbytes, int32_t offset)
+*	Inputs: int32_t fd = open regular file
+*			void* buf = buffer that holds the data read
+*			int32_t nbytes = number of bytes to read
+*			int32_t offset = position in the file to read from
+*	Return Value: N bytes read, 0 at or past the end, -1 on failure
+*	Function: Reads at offset without using or moving the file position
+*/
+int32_t syscall_pread(int32_t fd, void* buf, int32_t nbytes, int32_t offset) {
+	file_desc_t* file;
+	
+	if (buf == NULL || nbytes < 0 || offset < 0)
+		return -1;
+	
+	file = get_file(fd);
+	if (file == NULL || file->ops != &file_ops)
+		return -1;
+	
+	if (offset >= read_file_length(file->inode_num))
+		return 0;
+	return read_data(file->inode_num, offset, buf, nbytes);
+}
+
 /*
 * int32_t file_open(int32_t fd)
 *	Inputs: file_desc_t* file = pointer to file struct
@@ -182,8 +488,11 @@ int32_t dir_read(int32_t fd, void* buf, int32_t nbytes) {
 *	Function: Opens a file
 */
 int32_t file_open(int32_t fd) {
-	current_pcb->file_array[fd].file_pos = 0; // Initializes position to beginning of file
-	current_pcb->file_array[fd].flags = IN_USE; // Set file to in use
+	file_desc_t* file = get_file(fd);
+	
+	file->file_pos = 0; // Initializes position to beginning of file
+	file->ra_next = 0; // Reading from the start counts as sequential
+	file->ra_window = 0;
 
 	return 0;
 }
@@ -195,9 +504,10 @@ int32_t file_open(int32_t fd) {
 *	Function: Opens a directory
 */
 int32_t dir_open(int32_t fd) {
-	current_pcb->file_array[fd].file_pos = 0; // Initializes to beginning of directory entries
-	current_pcb->file_array[fd].inode_num = NULL; // Set to NULL for directory
-	current_pcb->file_array[fd].flags = IN_USE; // Set directory to in use
+	file_desc_t* dir = get_file(fd);
+	
+	dir->file_pos = 0; // Initializes to beginning of directory entries
+	dir->inode_num = NULL; // Set to NULL for directory
 	
 	return 0;
 }
@@ -232,6 +542,17 @@ int32_t file_write(int32_t fd, const void* buf, int32_t nbytes) {
 	return -1;
 }
 
+/*
+* uint32_t file_poll(int32_t fd, poll_table_t* pt)
+*	Inputs: none
+*	Return Value: POLLIN | POLLOUT
+*	Function: Files and the directory never make a reader wait for data
+*				to arrive, so they are always ready
+*/
+uint32_t file_poll(int32_t fd, poll_table_t* pt) {
+	return POLLIN | POLLOUT;
+}
+
 /*
 * int32_t dir_write(int32_t fd, const void* buf, int32_t nbytes)
 *	Inputs: none
@@ -8,6 +8,8 @@
 #include "types.h"
 #include "lib.h"
 #include "syscall.h"
+#include "blkdev.h"
+#include "sched.h"
 
 #define NAME_LEN 32			// Maximum length of file name
 #define RESERVED_52 52		// Reserved 52B memory
@@ -21,6 +23,12 @@
 #define TYPE_RTC 0
 #define TYPE_DIR 1
 #define TYPE_FILE 2
+#define TYPE_TERM 3			// Terminal descriptor, only reported by fstat
+#define SEEK_SET 0			// lseek from the start
+#define SEEK_CUR 1			// lseek from the current position
+#define SEEK_END 2			// lseek from the end
+#define RA_MIN_BLOCKS 2		// Read-ahead window of the first sequential read
+#define RA_MAX_BLOCKS 32	// Window limit, doubled on each sequential read
 
 /* Directory entry structure */
 typedef struct dentry_t {
@@ -30,6 +38,22 @@ typedef struct dentry_t {
 	uint8_t reserved[RESERVED_24];
 } dentry_t;
 
+/* Record filled in by getdents, as in ece391syscall.h */
+typedef struct dirent_t {
+	uint32_t inode_num;
+	uint32_t f_type;	// TYPE_RTC, TYPE_DIR or TYPE_FILE
+	uint32_t length;	// Bytes in a regular file, 0 otherwise
+	uint8_t fname[NAME_LEN + 1];	// NUL terminated
+} dirent_t;
+
+/* File information filled in by stat and fstat, as in ece391syscall.h */
+typedef struct stat_t {
+	uint32_t f_type;	// TYPE_RTC, TYPE_DIR, TYPE_FILE or TYPE_TERM
+	uint32_t inode_num;
+	uint32_t length;	// Bytes in a regular file, 0 otherwise
+	uint32_t blocks;	// Data blocks holding them
+} stat_t;
+
 /* Boot Block */
 typedef struct boot_block_t {
 	uint32_t d_entries;
@@ -45,25 +69,37 @@ typedef struct inode_t {
 	uint32_t data_blocks[MAX_DATA_BLOCKS];
 } inode_t;
 
-/* Pointer to FS boot block */
+/* Pointer to FS boot block, in the module or copied from disk */
 extern boot_block_t* fs_boot;
+/* Boot module image, used until a disk with the file system is mounted */
+extern boot_block_t* fs_module;
+
+/* Switch to the file system on a block device if one has it */
+int32_t fs_mount(void);
 
 /* Helper functions to read files */
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
 uint32_t read_file_length(uint32_t inode);
+void read_ahead(uint32_t inode, uint32_t offset, uint32_t nblocks);
 
 /* File operations */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t file_open(int32_t fd);
 int32_t file_close(int32_t fd);
 int32_t file_write(int32_t fd, const void* buf, int32_t nbytes);
+uint32_t file_poll(int32_t fd, poll_table_t* pt);
 
 /* Directory operations */
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t dir_open(int32_t fd);
 int32_t dir_close(int32_t fd);
 int32_t dir_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t syscall_getdents(int32_t fd, dirent_t* buf, int32_t nbytes);
+int32_t syscall_stat(const uint8_t* fname, stat_t* buf);
+int32_t syscall_fstat(int32_t fd, stat_t* buf);
+int32_t syscall_lseek(int32_t fd, int32_t offset, int32_t whence);
+int32_t syscall_pread(int32_t fd, void* buf, int32_t nbytes, int32_t offset);
 
 #endif
@@ -0,0 +1,208 @@
+/* fpu.c - Lazy switching of the x87/SSE register state. CR0.TS is set
+ * whenever a CPU changes process; the first FPU or SSE instruction after
+ * that traps (#NM) and only then is the process's saved state loaded.
+ * Processes that never touch the FPU never pay for a save or restore.
+ * vim:ts=4 noexpandtab
+ */
+
+#include "fpu.h"
+#include "smp.h"
+#include "syscall.h"
+
+/* Set when the CPU has FXSAVE/FXRSTOR, otherwise FNSAVE/FRSTOR are used */
+static uint32_t has_fxsr;
+
+static inline uint32_t
+read_cr0(void)
+{
+	uint32_t cr0;
+	asm volatile("movl %%cr0, %0" : "=r"(cr0));
+	return cr0;
+}
+
+static inline void
+write_cr0(uint32_t cr0)
+{
+	asm volatile("movl %0, %%cr0" : : "r"(cr0) : "memory");
+}
+
+static inline void
+set_ts(void)
+{
+	uint32_t cr0 = read_cr0();
+
+	if (!(cr0 & CR0_TS_FLAG))
+		write_cr0(cr0 | CR0_TS_FLAG);
+}
+
+static inline void
+fpu_save(uint8_t* state)
+{
+	if (has_fxsr)
+		asm volatile("fxsave (%0)" : : "r"(state) : "memory");
+	else
+		asm volatile("fnsave (%0)" : : "r"(state) : "memory");
+}
+
+static inline void
+fpu_restore(uint8_t* state)
+{
+	if (has_fxsr)
+		asm volatile("fxrstor (%0)" : : "r"(state) : "memory");
+	else
+		asm volatile("frstor (%0)" : : "r"(state) : "memory");
+}
+
+/*
+ * fpu_init
+ *   DESCRIPTION: Enables native x87 error reporting and, when the CPU has
+ *                them, FXSAVE and SSE on the calling CPU. TS is left set
+ *                so the first process to use the FPU traps.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+fpu_init(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+	uint32_t cr4;
+
+	cpuid(CPUID_FEATURES, 0, &eax, &ebx, &ecx, &edx);
+	has_fxsr = (edx & CPUID_EDX_FXSR) != 0;
+
+	asm volatile("movl %%cr4, %0" : "=r"(cr4));
+	if (has_fxsr)
+		cr4 |= CR4_OSFXSR_FLAG;
+	if (edx & CPUID_EDX_SSE)
+		cr4 |= CR4_OSXMMEXCPT_FLAG;
+	asm volatile("movl %0, %%cr4" : : "r"(cr4));
+
+	write_cr0((read_cr0() & ~CR0_EM_FLAG) | CR0_MP_FLAG | CR0_TS_FLAG);
+	this_cpu()->fpu_owner = NULL;
+}
+
+/*
+ * fpu_trap
+ *   DESCRIPTION: #NM handler. Clears TS and, unless this CPU's registers
+ *                still hold the running process's state, loads its saved
+ *                state (or a clean one on its first use). The previous
+ *                owner's state was saved when it was switched out.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 if the instruction can be retried, -1 if no process
+ *                 is running
+ */
+int32_t
+fpu_trap(void)
+{
+	cpu_t* cpu = this_cpu();
+	pcb_t* proc = cpu->current;
+	uint32_t mxcsr = MXCSR_DEFAULT;
+
+	if (proc == NULL)
+		return -1;
+
+	asm volatile("clts");
+
+	if (proc->fpu_used && cpu->fpu_owner == proc && proc->fpu_cpu == cpu->id)
+		return 0;
+
+	if (proc->fpu_used) {
+		fpu_restore(proc->fpu_state);
+	} else {
+		asm volatile("fninit");
+		if (has_fxsr)
+			asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+		proc->fpu_used = 1;
+	}
+
+	cpu->fpu_owner = proc;
+	proc->fpu_cpu = cpu->id;
+
+	return 0;
+}
+
+/*
+ * fpu_switch_out
+ *   DESCRIPTION: Called before a CPU stops running a process. If the
+ *                process used the FPU since it was switched in (TS is
+ *                clear) its registers are saved, so it can resume on any
+ *                CPU. The registers stay valid here, so coming back to
+ *                this CPU with no other FPU user in between costs only
+ *                the trap.
+ *   INPUTS: pcb_t* prev - process giving up the CPU, NULL for the idle loop
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+fpu_switch_out(pcb_t* prev)
+{
+	if (read_cr0() & CR0_TS_FLAG)
+		return;
+
+	if (prev != NULL && this_cpu()->fpu_owner == prev)
+		fpu_save(prev->fpu_state);
+	set_ts();
+}
+
+/*
+ * fpu_release
+ *   DESCRIPTION: Drops the FPU state of a halting process without saving it
+ *   INPUTS: pcb_t* proc - halting process, running on this CPU
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+fpu_release(pcb_t* proc)
+{
+	cpu_t* cpu = this_cpu();
+
+	if (cpu->fpu_owner == proc)
+		cpu->fpu_owner = NULL;
+	set_ts();
+}
+
+/*
+ * kernel_fpu_begin
+ *   DESCRIPTION: Lets kernel code use the FPU and SSE registers. A live
+ *                process state in the registers is saved to its PCB first
+ *                and nobody owns the registers afterwards, so the process
+ *                reloads it on its next FPU instruction.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: saved flags to pass to kernel_fpu_end
+ */
+uint32_t
+kernel_fpu_begin(void)
+{
+	uint32_t flags;
+	cpu_t* cpu;
+
+	cli_and_save(flags);
+	cpu = this_cpu();
+
+	if (!(read_cr0() & CR0_TS_FLAG)) {
+		if (cpu->fpu_owner != NULL)
+			fpu_save(cpu->fpu_owner->fpu_state);
+	} else {
+		asm volatile("clts");
+	}
+	cpu->fpu_owner = NULL;
+
+	return flags;
+}
+
+/*
+ * kernel_fpu_end
+ *   DESCRIPTION: Ends a kernel_fpu_begin section
+ *   INPUTS: uint32_t flags - value returned by kernel_fpu_begin
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+kernel_fpu_end(uint32_t flags)
+{
+	set_ts();
+	restore_flags(flags);
+}
@@ -0,0 +1,35 @@
+/* fpu.h - Lazy switching of the x87/SSE register state
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FPU_H
+#define _FPU_H
+
+#include "types.h"
+
+#define FPU_STATE_SIZE 512			// FXSAVE area, FNSAVE uses the first 108 bytes
+#define DEVICE_NOT_AVAILABLE_VECTOR 7
+
+#define CR0_MP_FLAG		0x00000002	// WAIT honours TS
+#define CR0_EM_FLAG		0x00000004	// Emulate x87, must be clear
+#define CR0_TS_FLAG		0x00000008	// Next FPU/SSE instruction raises #NM
+#define CR4_OSFXSR_FLAG	0x00000200	// FXSAVE/FXRSTOR and SSE enabled
+#define CR4_OSXMMEXCPT_FLAG 0x00000400	// Unmasked SSE exceptions raise #XM
+
+#define MXCSR_DEFAULT	0x1F80		// All SSE exceptions masked, round to nearest
+
+struct pcb_t;
+
+/* Enable the FPU and SSE on the calling CPU, with TS set */
+void fpu_init(void);
+/* #NM handler, gives the FPU to the running process */
+int32_t fpu_trap(void);
+/* Save the running process's FPU state if it used the FPU, then set TS */
+void fpu_switch_out(struct pcb_t* prev);
+/* Forget the FPU state of a halting process */
+void fpu_release(struct pcb_t* proc);
+/* Let the kernel use SSE registers, with interrupts off until kernel_fpu_end */
+uint32_t kernel_fpu_begin(void);
+void kernel_fpu_end(uint32_t flags);
+
+#endif /* _FPU_H */
@@ -43,49 +43,59 @@ i8259_init(void)
 	restore_flags(flags);
 }
 
-/* Enable (unmask) the specified IRQ */
+/* Bit n set when IRQ n is unmasked */
+uint32_t
+i8259_enabled(void)
+{
+	return ~((slave_mask << NUM_IRQS) | master_mask) & ((1 << (2 * NUM_IRQS)) - 1);
+}
+
+/* Mask every IRQ, used when the IOAPIC takes over */
 void
-enable_irq(uint32_t irq_num)
+i8259_mask_all(void)
 {
-	uint8_t generic_mask;
+	master_mask = MASK_ALL;
+	slave_mask = MASK_ALL;
+	outb(master_mask, MASTER_8259_DATA);
+	outb(slave_mask, SLAVE_8259_DATA);
+}
 
+/* Enable (unmask) the specified IRQ. The masks are cached, the PIC is
+ * only written, never read back. */
+static void
+i8259_enable_irq(uint32_t irq_num)
+{
 	if (irq_num < NUM_IRQS) {
-		generic_mask = ~(1 << irq_num);
-		master_mask = (uint8_t) inb(MASTER_8259_DATA) & generic_mask;
+		master_mask &= ~(1 << irq_num);
 		outb(master_mask, MASTER_8259_DATA);
 	}
 
 	else {
 		irq_num = irq_num - NUM_IRQS;
-		generic_mask = ~(1 << irq_num);
-		slave_mask = (uint8_t) inb(SLAVE_8259_DATA) & generic_mask;
+		slave_mask &= ~(1 << irq_num);
 		outb(slave_mask, SLAVE_8259_DATA);
 	}
 }
 
 /* Disable (mask) the specified IRQ */
-void
-disable_irq(uint32_t irq_num)
+static void
+i8259_disable_irq(uint32_t irq_num)
 {
-	uint8_t generic_mask;
-	
 	if (irq_num < NUM_IRQS) {
-		generic_mask = (1 << irq_num);
-		master_mask = (uint8_t) inb(MASTER_8259_DATA) | generic_mask;
+		master_mask |= (1 << irq_num);
 		outb(master_mask, MASTER_8259_DATA);
 	}
 
 	else {
 		irq_num = irq_num - NUM_IRQS;
-		generic_mask = (1 << irq_num);
-		slave_mask = (uint8_t) inb(SLAVE_8259_DATA) | generic_mask;
+		slave_mask |= (1 << irq_num);
 		outb(slave_mask, SLAVE_8259_DATA);
 	}
 }
 
 /* Send end-of-interrupt signal for the specified IRQ */
-void
-send_eoi(uint32_t irq_num)
+static void
+i8259_send_eoi(uint32_t irq_num)
 {
 	if (irq_num & 8) {
 		outb(EOI + (irq_num & 7), SLAVE_8259_PORT);
@@ -96,3 +106,18 @@ send_eoi(uint32_t irq_num)
 		outb(EOI + irq_num, MASTER_8259_PORT);
 	}
 }
+
+/* Every 8259 interrupt goes to the boot processor */
+static int32_t
+i8259_set_affinity(uint32_t irq_num, uint32_t cpu)
+{
+	return (cpu == 0) ? 0 : -1;
+}
+
+irq_chip_t i8259_chip = {
+	.name = "8259",
+	.enable = i8259_enable_irq,
+	.disable = i8259_disable_irq,
+	.eoi = i8259_send_eoi,
+	.set_affinity = i8259_set_affinity,
+};
@@ -7,6 +7,7 @@
 #define _I8259_H
 
 #include "types.h"
+#include "irq.h"
 
 /* Ports that each PIC sits on */
 #define MASTER_8259_PORT 0x20
@@ -38,11 +39,12 @@
 
 /* Initialize both PICs */
 void i8259_init(void);
-/* Enable (unmask) the specified IRQ */
-void enable_irq(uint32_t irq_num);
-/* Disable (mask) the specified IRQ */
-void disable_irq(uint32_t irq_num);
-/* Send end-of-interrupt signal for the specified IRQ */
-void send_eoi(uint32_t irq_num);
+/* Bit n set when IRQ n is unmasked */
+uint32_t i8259_enabled(void);
+/* Mask every IRQ, used when the IOAPIC takes over */
+void i8259_mask_all(void);
+
+/* Backend for irq.c */
+extern irq_chip_t i8259_chip;
 
 #endif /* _I8259_H */
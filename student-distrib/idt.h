@@ -2,6 +2,8 @@
 #include "x86_desc.h"
 #include "types.h"
 #include "syscall_handler.h"
+#include "intr_entry.h"
+#include "apic.h"
 
 #define IDT_SYSCALL_INDEX 0x80 
 #define USER_PRIV 3
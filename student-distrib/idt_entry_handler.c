@@ -1,6 +1,23 @@
 #include "idt_entry_handler.h"
-
-volatile int rtc_interrupted;
+#include "intr_entry.h"
+#include "irq.h"
+#include "softirq.h"
+#include "apic.h"
+#include "page_init.h"
+#include "signal.h"
+#include "syscall.h"
+#include "elf.h"
+#include "fpu.h"
+
+/* Reporting handlers of the processor exceptions, by vector */
+static void (*exception_table[NUM_EXCEPTIONS])() = {
+	divide_error, debug, nmi, int3, overflow, bounds, invalid_op,
+	device_not_available, doublefault_fn, coprocessor_segment_overrun,
+	invalid_tss, segment_not_present, stack_segment, general_protection,
+	page_fault, reserved_by_intel, coprocessor_error, alignment_check,
+	machine_check, simd_coprocessor_error,
+	[20 ... NUM_EXCEPTIONS - 1] = reserved_by_intel
+};
 
 void divide_error() {
 	printf("EXCEPTION: Division by Zero\n");
@@ -108,11 +125,66 @@ void reserved_by_intel() {
 	while(1);
 }
 
-void keyboard_interrupt() {
-	kb_handler();
-}
-
-void rtc_interrupt() {
-	rtc_interrupted = 1;
-	rtc_handler();
+/*
+ * do_interrupt
+ *   DESCRIPTION: Common C entry point of every interrupt stub. Heap and
+ *                program image page faults are fixed up and retried, other
+ *                exceptions go to their reporting handler and IRQs to the
+ *                handlers registered with request_irq, followed by any
+ *                tasklets they queued. Exceptions raised in user mode are
+ *                turned into signals, delivered before returning to user
+ *                mode; a kernel page fault on a user address kills the
+ *                process whose syscall made it.
+ *   INPUTS: intr_frame_t* frame - registers saved by the stub
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void do_interrupt(intr_frame_t* frame) {
+	uint32_t vector = frame->vector;
+	uint32_t fault_address = 0;
+
+	if (vector == PAGE_FAULT_VECTOR) {
+		asm volatile("mov %%cr2, %0":"=r" (fault_address));
+		if (heap_fault(fault_address, frame->error_code) == 0 ||
+			elf_fault(fault_address, frame->error_code) == 0)
+			return;
+	}
+
+	/* First FPU/SSE instruction since the last process switch */
+	if (vector == DEVICE_NOT_AVAILABLE_VECTOR && fpu_trap() == 0)
+		return;
+
+	if (vector < NUM_EXCEPTIONS) {
+		/* Faults caused by a user program become signals to it */
+		if ((frame->cs & USER_RPL_MASK) && vector != NMI_VECTOR && vector != MACHINE_CHECK_VECTOR)
+			send_fault_signal((vector == DIVIDE_ERROR_VECTOR) ? SIG_DIV_ZERO : SIG_SEGFAULT);
+		/* So are bad user buffers handed to a syscall. The kernel cannot
+		 * retry the access or unwind the call, so the caller gets the
+		 * default action of SIGSEGV right away. */
+		else if (vector == PAGE_FAULT_VECTOR && fault_address >= USER_MEM_START && current_pcb != NULL)
+			sig_default(SIG_SEGFAULT);
+		else
+			exception_table[vector](frame->eip, frame->error_code);
+	}
+
+	else if (vector >= IRQ_VECTOR_BASE && vector < IRQ_VECTOR_BASE + NUM_ISA_IRQS) {
+		do_irq(vector - IRQ_VECTOR_BASE);
+		do_softirq();
+	}
+
+	else {
+		switch (vector) {
+			case LAPIC_TIMER_VECTOR:
+				/* Only user code may be preempted */
+				lapic_timer_handler(frame->cs & USER_RPL_MASK);
+				break;
+			case LAPIC_SPURIOUS_VECTOR:
+				/* Must not be acknowledged */
+				break;
+			default:
+				break;
+		}
+	}
+
+	do_signal(frame);
 }
@@ -24,6 +24,4 @@ void machine_check();
 void simd_coprocessor_error();
 void reserved_by_intel();
 
-
-void keyboard_interrupt();
-void rtc_interrupt();
+#define USER_RPL_MASK 3	// Low bits of CS, nonzero when interrupted in user mode
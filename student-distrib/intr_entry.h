@@ -0,0 +1,52 @@
+/* intr_entry.h - Assembly entry points for every interrupt vector
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _INTR_ENTRY_H
+#define _INTR_ENTRY_H
+
+#define NUM_VECTORS 256
+#define NUM_EXCEPTIONS 32
+#define INTR_STUB_SIZE 16		// Bytes per stub in intr_stubs
+#define NMI_VECTOR 2
+#define PAGE_FAULT_VECTOR 14
+#define MACHINE_CHECK_VECTOR 18
+
+#ifndef ASM
+
+#include "types.h"
+
+/* Stack built by an entry stub or the system call entry, lowest address
+ * first. Same layout as the hardware context in a user signal frame. */
+typedef struct intr_frame_t {
+	uint32_t ebx;
+	uint32_t ecx;
+	uint32_t edx;
+	uint32_t esi;
+	uint32_t edi;
+	uint32_t ebp;
+	uint32_t eax;
+	uint32_t ds;
+	uint32_t es;
+	uint32_t fs;
+
+	uint32_t vector;		// Vector, or system call number
+	uint32_t error_code;	// Zero for vectors without one
+
+	/* Pushed by the processor */
+	uint32_t eip;
+	uint32_t cs;
+	uint32_t eflags;
+	uint32_t user_esp;		// Only present when coming from ring 3
+	uint32_t user_ss;
+} intr_frame_t;
+
+/* Start of the entry stubs, one every INTR_STUB_SIZE bytes */
+extern uint8_t intr_stubs[];
+
+/* Common C entry point of every stub */
+void do_interrupt(intr_frame_t* frame);
+
+#endif /* ASM */
+
+#endif /* _INTR_ENTRY_H */
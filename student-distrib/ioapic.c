@@ -0,0 +1,171 @@
+/* ioapic.c - Functions to interact with the I/O APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ioapic.h"
+#include "apic.h"
+#include "smp.h"
+#include "page_init.h"
+#include "lib.h"
+
+/* Mapped IOAPIC registers, NULL when the MP table listed none */
+static volatile uint32_t* ioapic = NULL;
+static uint32_t ioapic_pins;
+static spinlock_t ioapic_lock = SPIN_LOCK_UNLOCKED;
+
+/* Pin of each ISA IRQ and the low word last written to it. Masking
+ * updates the cached word, the IOAPIC is never read back. */
+static uint8_t isa_pin[NUM_ISA_IRQS];
+static uint32_t redir_low[NUM_ISA_IRQS];
+
+/* Write an indirect IOAPIC register */
+static void
+ioapic_write(uint32_t reg, uint32_t val)
+{
+	ioapic[IOAPIC_REGSEL] = reg;
+	ioapic[IOAPIC_WIN] = val;
+}
+
+/* Read an indirect IOAPIC register */
+static uint32_t
+ioapic_read(uint32_t reg)
+{
+	ioapic[IOAPIC_REGSEL] = reg;
+	return ioapic[IOAPIC_WIN];
+}
+
+/*
+ * ioapic_add
+ *   DESCRIPTION: Records an IOAPIC from the MP table. ISA IRQs start out
+ *                wired to the pin of the same number, edge triggered and
+ *                active high; IRQ 2 is the 8259 cascade and has no pin.
+ *   INPUTS: uint32_t addr - physical address of its registers
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+ioapic_add(uint32_t addr)
+{
+	uint32_t i;
+
+	/* Only the 4MB APIC page is mapped */
+	if (ioapic != NULL || (addr >> PD_SHIFT) != (APIC_PAGE_ADDR >> PD_SHIFT))
+		return;
+
+	ioapic = (volatile uint32_t*)addr;
+	for (i = 0; i < NUM_ISA_IRQS; i++) {
+		isa_pin[i] = (i == 2) ? IOAPIC_NO_PIN : i;
+		redir_low[i] = (IRQ_VECTOR_BASE + i) | REDIR_MASKED;
+	}
+}
+
+/* Record the pin and polarity/trigger bits an ISA IRQ is wired to */
+void
+ioapic_isa_route(uint32_t irq_num, uint32_t pin, uint32_t redir_flags)
+{
+	uint32_t i;
+
+	if (ioapic == NULL || irq_num >= NUM_ISA_IRQS)
+		return;
+
+	/* An override moves the pin away from the IRQ that had it by default */
+	for (i = 0; i < NUM_ISA_IRQS; i++) {
+		if (isa_pin[i] == pin)
+			isa_pin[i] = IOAPIC_NO_PIN;
+	}
+
+	isa_pin[irq_num] = pin;
+	redir_low[irq_num] = (IRQ_VECTOR_BASE + irq_num) | redir_flags | REDIR_MASKED;
+}
+
+/*
+ * ioapic_init
+ *   DESCRIPTION: Masks every pin, then points each ISA IRQ's pin at its
+ *                vector, still masked, delivered to the boot processor
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if there is no IOAPIC
+ */
+int32_t
+ioapic_init(void)
+{
+	uint32_t i;
+
+	if (ioapic == NULL)
+		return -1;
+
+	ioapic_pins = ((ioapic_read(IOAPIC_REG_VER) >> IOAPIC_MAXREDIR_SHIFT) & 0xFF) + 1;
+
+	for (i = 0; i < ioapic_pins; i++)
+		ioapic_write(IOAPIC_REDTBL + 2 * i, REDIR_MASKED);
+
+	for (i = 0; i < NUM_ISA_IRQS; i++) {
+		if (isa_pin[i] >= ioapic_pins)
+			continue;
+		ioapic_write(IOAPIC_REDTBL + 2 * isa_pin[i] + 1, cpus[0].apic_id << REDIR_DEST_SHIFT);
+		ioapic_write(IOAPIC_REDTBL + 2 * isa_pin[i], redir_low[i]);
+	}
+
+	return 0;
+}
+
+/* Enable (unmask) the specified IRQ */
+static void
+ioapic_enable_irq(uint32_t irq_num)
+{
+	uint32_t flags;
+
+	if (isa_pin[irq_num] >= ioapic_pins)
+		return;
+
+	spin_lock_irqsave(&ioapic_lock, flags);
+	redir_low[irq_num] &= ~REDIR_MASKED;
+	ioapic_write(IOAPIC_REDTBL + 2 * isa_pin[irq_num], redir_low[irq_num]);
+	spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+/* Disable (mask) the specified IRQ */
+static void
+ioapic_disable_irq(uint32_t irq_num)
+{
+	uint32_t flags;
+
+	if (isa_pin[irq_num] >= ioapic_pins)
+		return;
+
+	spin_lock_irqsave(&ioapic_lock, flags);
+	redir_low[irq_num] |= REDIR_MASKED;
+	ioapic_write(IOAPIC_REDTBL + 2 * isa_pin[irq_num], redir_low[irq_num]);
+	spin_unlock_irqrestore(&ioapic_lock, flags);
+}
+
+/* End of interrupt is a single write to the local APIC */
+static void
+ioapic_send_eoi(uint32_t irq_num)
+{
+	lapic_eoi();
+}
+
+/* Deliver the specified IRQ to one online CPU */
+static int32_t
+ioapic_set_affinity(uint32_t irq_num, uint32_t cpu)
+{
+	uint32_t flags;
+
+	if (isa_pin[irq_num] >= ioapic_pins || cpu >= num_cpus || !cpus[cpu].online)
+		return -1;
+
+	spin_lock_irqsave(&ioapic_lock, flags);
+	ioapic_write(IOAPIC_REDTBL + 2 * isa_pin[irq_num] + 1, cpus[cpu].apic_id << REDIR_DEST_SHIFT);
+	spin_unlock_irqrestore(&ioapic_lock, flags);
+
+	return 0;
+}
+
+irq_chip_t ioapic_chip = {
+	.name = "IOAPIC",
+	.enable = ioapic_enable_irq,
+	.disable = ioapic_disable_irq,
+	.eoi = ioapic_send_eoi,
+	.set_affinity = ioapic_set_affinity,
+};
@@ -0,0 +1,38 @@
+/* ioapic.h - Defines used in interactions with the I/O APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IOAPIC_H
+#define _IOAPIC_H
+
+#include "types.h"
+#include "irq.h"
+
+/* Memory-mapped register select and data window (word offsets) */
+#define IOAPIC_REGSEL	0x00
+#define IOAPIC_WIN		0x04
+
+/* Indirect registers */
+#define IOAPIC_REG_VER	0x01
+#define IOAPIC_REDTBL	0x10	// Two registers per pin, low word first
+#define IOAPIC_MAXREDIR_SHIFT 16
+
+/* Redirection entry fields */
+#define REDIR_MASKED		0x00010000
+#define REDIR_LEVEL			0x00008000
+#define REDIR_ACTIVE_LOW	0x00002000
+#define REDIR_DEST_SHIFT	24
+
+#define IOAPIC_NO_PIN	0xFF
+
+/* Record the IOAPIC found in the MP table, only the first one is used */
+void ioapic_add(uint32_t addr);
+/* Record the pin and polarity/trigger bits an ISA IRQ is wired to */
+void ioapic_isa_route(uint32_t irq_num, uint32_t pin, uint32_t redir_flags);
+/* Mask every pin and program ISA IRQ vectors, -1 without an IOAPIC */
+int32_t ioapic_init(void);
+
+/* Backend for irq.c */
+extern irq_chip_t ioapic_chip;
+
+#endif /* _IOAPIC_H */
@@ -0,0 +1,130 @@
+/* ioring.c - Batched reads and writes through rings in user memory. A
+ * process fills submission entries and makes one ring_enter call for all
+ * of them; completions are posted to its completion ring, which it reaps
+ * without another trap. Disk reads for the whole batch are queued before
+ * the first one is run, so the I/O scheduler sees them together.
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ioring.h"
+#include "syscall.h"
+
+/* The ring must lie in the program region or in the heap below the break */
+static int32_t
+ring_addr_ok(io_ring_t* ring)
+{
+	uint32_t start = (uint32_t)ring;
+	uint32_t end = start + sizeof(io_ring_t);
+
+	if (ring == NULL || end < start)
+		return 0;
+	if (start >= PROG_VIRT_ADDR && end <= USER_STACK)
+		return 1;
+	return start >= HEAP_VIRT_ADDR && end <= current_pcb->heap_brk;
+}
+
+/*
+ * ring_prefetch
+ *   DESCRIPTION: Starts the disk reads of every file read among the next n
+ *                submissions, following each file's position as the reads
+ *                before it would move it
+ *   INPUTS: io_ring_t* ring - validated ring
+ *           uint32_t head - first submission
+ *           uint32_t n - number of submissions
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+static void
+ring_prefetch(io_ring_t* ring, uint32_t head, uint32_t n)
+{
+	uint32_t pos[FD_MAX];
+	file_desc_t* file;
+	io_sqe_t* sqe;
+	uint32_t i;
+
+	for (i = 0; i < FD_MAX; i++)
+		pos[i] = (get_file(i) != NULL) ? get_file(i)->file_pos : 0;
+
+	for (i = 0; i < n; i++) {
+		sqe = &ring->sq[(head + i) & IORING_MASK];
+		if (sqe->opcode != IORING_OP_READ || sqe->len <= 0)
+			continue;
+		file = get_file(sqe->fd);
+		if (file == NULL || file->ops != &file_ops)
+			continue;
+
+		read_ahead(file->inode_num, pos[sqe->fd],
+				(pos[sqe->fd] % BLOCK_SIZE + sqe->len + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		pos[sqe->fd] += sqe->len;
+	}
+}
+
+/* Run one submission, copied out of the ring first */
+static int32_t
+ring_op(io_sqe_t* sqe)
+{
+	switch (sqe->opcode) {
+	case IORING_OP_NOP:
+		return 0;
+	case IORING_OP_READ:
+		return syscall_read(sqe->fd, sqe->buf, sqe->len);
+	case IORING_OP_WRITE:
+		return syscall_write(sqe->fd, sqe->buf, sqe->len);
+	default:
+		return -1;
+	}
+}
+
+/*
+ * syscall_ring_enter
+ *   DESCRIPTION: Runs submissions from the head of the submission ring in
+ *                order, each as a read or write on its fd, and posts its
+ *                result to the completion ring. Stops after to_submit, when
+ *                the completion ring is full, or when a signal is waiting.
+ *   INPUTS: io_ring_t* ring - rings of the calling process
+ *           uint32_t to_submit - most submissions to consume, 0 to only
+ *                                check the ring
+ *   OUTPUTS: completions in ring->cq, advanced sq_head and cq_tail
+ *   RETURN VALUE: number of submissions consumed, -1 for a bad ring
+ */
+int32_t
+syscall_ring_enter(io_ring_t* ring, uint32_t to_submit)
+{
+	io_sqe_t sqe;
+	io_cqe_t* cqe;
+	uint32_t head, queued, room, n, i;
+	pcb_t* proc = current_pcb;
+
+	if (!ring_addr_ok(ring))
+		return -1;
+
+	head = ring->sq_head;
+	queued = ring->sq_tail - head;
+	room = IORING_ENTRIES - (ring->cq_tail - ring->cq_head);
+	if (queued > IORING_ENTRIES || room > IORING_ENTRIES)
+		return -1;
+
+	n = queued;
+	if (n > to_submit)
+		n = to_submit;
+	if (n > room)
+		n = room;
+
+	ring_prefetch(ring, head, n);
+
+	for (i = 0; i < n; i++) {
+		sqe = ring->sq[(head + i) & IORING_MASK];
+		cqe = &ring->cq[ring->cq_tail & IORING_MASK];
+		cqe->user_data = sqe.user_data;
+		cqe->res = ring_op(&sqe);
+		ring->sq_head = head + i + 1;
+		ring->cq_tail++;
+
+		if (signal_pending(proc)) {
+			i++;
+			break;
+		}
+	}
+
+	return i;
+}
@@ -0,0 +1,49 @@
+/* ioring.h - Submission and completion rings shared with a process, for
+ * queueing many reads and writes per system call
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IORING_H
+#define _IORING_H
+
+#include "types.h"
+
+#define IORING_ENTRIES	32		// Slots in each ring, a power of two
+#define IORING_MASK		(IORING_ENTRIES - 1)
+
+/* Submission opcodes */
+#define IORING_OP_NOP	0
+#define IORING_OP_READ	1
+#define IORING_OP_WRITE	2
+
+/* One read or write queued by the process */
+typedef struct io_sqe_t {
+	uint32_t opcode;
+	int32_t fd;
+	void* buf;
+	int32_t len;
+	uint32_t user_data;	// Handed back untouched in the completion
+} io_sqe_t;
+
+/* Result of one submission */
+typedef struct io_cqe_t {
+	uint32_t user_data;
+	int32_t res;		// What read or write returned
+} io_cqe_t;
+
+/* Both rings live in the process's own memory. Indices run freely and are
+ * taken modulo IORING_ENTRIES; the process only advances sq_tail and
+ * cq_head, the kernel only sq_head and cq_tail. */
+typedef struct io_ring_t {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	io_sqe_t sq[IORING_ENTRIES];
+	io_cqe_t cq[IORING_ENTRIES];
+} io_ring_t;
+
+/* Run up to to_submit queued submissions, posting a completion for each */
+int32_t syscall_ring_enter(io_ring_t* ring, uint32_t to_submit);
+
+#endif /* _IORING_H */
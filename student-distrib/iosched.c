@@ -0,0 +1,207 @@
+/* iosched.c - noop and deadline I/O schedulers. Both keep the queued
+ * requests on the queue's head/tail list, noop in arrival order and
+ * deadline sorted by sector with per-direction FIFOs for expiry.
+ * Callers hold the queue lock.
+ * vim:ts=4 noexpandtab
+ */
+
+#include "iosched.h"
+#include "lib.h"
+
+static elevator_t* elevators[] = { &noop_elevator, &deadline_elevator };
+
+#define NUM_ELEVATORS (sizeof(elevators) / sizeof(elevators[0]))
+
+/* Scheduler by name, NULL if there is none */
+elevator_t*
+elevator_find(const int8_t* name)
+{
+	uint32_t i;
+
+	for (i = 0; i < NUM_ELEVATORS; i++) {
+		if (strncmp(name, (int8_t*)elevators[i]->name, IOSCHED_NAME_LEN) == 0)
+			return elevators[i];
+	}
+
+	return NULL;
+}
+
+/*
+ * req_merge
+ *   DESCRIPTION: Adds a block to a request when it is adjacent to either
+ *                end and the request has room for another segment
+ *   INPUTS: blk_req_t* req - queued request
+ *           buf_head_t* bh - block to transfer
+ *           uint32_t dir - BLK_READ or BLK_WRITE
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if merged, 0 otherwise
+ */
+int32_t
+req_merge(blk_req_t* req, buf_head_t* bh, uint32_t dir)
+{
+	uint32_t sector = bh->block * SECTORS_PER_BLK;
+	uint32_t i;
+
+	if (req->dir != dir || req->nsegs == BLK_MAX_SEGS)
+		return 0;
+
+	if (req->sector + req->count == sector) {
+		req->bh[req->nsegs++] = bh;
+	} else if (sector + SECTORS_PER_BLK == req->sector) {
+		for (i = req->nsegs; i > 0; i--)
+			req->bh[i] = req->bh[i - 1];
+		req->bh[0] = bh;
+		req->nsegs++;
+		req->sector = sector;
+	} else {
+		return 0;
+	}
+
+	req->count += SECTORS_PER_BLK;
+	return 1;
+}
+
+/* Insert a request into the scheduler list after prev, NULL for the front */
+static void
+list_insert(blk_queue_t* q, blk_req_t* prev, blk_req_t* req)
+{
+	req->prev = prev;
+	req->next = (prev == NULL) ? q->head : prev->next;
+	if (req->next != NULL)
+		req->next->prev = req;
+	else
+		q->tail = req;
+	if (prev != NULL)
+		prev->next = req;
+	else
+		q->head = req;
+}
+
+/* Remove a request from the scheduler list */
+static void
+list_remove(blk_queue_t* q, blk_req_t* req)
+{
+	if (req->prev != NULL)
+		req->prev->next = req->next;
+	else
+		q->head = req->next;
+	if (req->next != NULL)
+		req->next->prev = req->prev;
+	else
+		q->tail = req->prev;
+}
+
+/* Newest request is the only merge candidate */
+static int32_t
+noop_merge(blk_queue_t* q, buf_head_t* bh, uint32_t dir)
+{
+	return q->tail != NULL && req_merge(q->tail, bh, dir);
+}
+
+static void
+noop_add(blk_queue_t* q, blk_req_t* req)
+{
+	list_insert(q, q->tail, req);
+}
+
+static blk_req_t*
+noop_next(blk_queue_t* q)
+{
+	blk_req_t* req = q->head;
+
+	if (req != NULL)
+		list_remove(q, req);
+	return req;
+}
+
+elevator_t noop_elevator = {
+	.name = "noop",
+	.merge = noop_merge,
+	.add = noop_add,
+	.next = noop_next,
+};
+
+/* Any queued request is a merge candidate */
+static int32_t
+deadline_merge(blk_queue_t* q, buf_head_t* bh, uint32_t dir)
+{
+	blk_req_t* req;
+
+	for (req = q->head; req != NULL; req = req->next) {
+		if (req_merge(req, bh, dir))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Sort by sector and append to the direction's FIFO with its deadline */
+static void
+deadline_add(blk_queue_t* q, blk_req_t* req)
+{
+	blk_req_t* prev = q->tail;
+
+	while (prev != NULL && prev->sector > req->sector)
+		prev = prev->prev;
+	list_insert(q, prev, req);
+
+	req->deadline = req->submitted + ((req->dir == BLK_READ) ? READ_EXPIRE : WRITE_EXPIRE);
+	req->fifo_next = NULL;
+	req->fifo_prev = q->fifo_tail[req->dir];
+	if (q->fifo_tail[req->dir] != NULL)
+		q->fifo_tail[req->dir]->fifo_next = req;
+	else
+		q->fifo_head[req->dir] = req;
+	q->fifo_tail[req->dir] = req;
+}
+
+/*
+ * deadline_next
+ *   DESCRIPTION: Picks the oldest expired request, reads before writes.
+ *                Otherwise continues the sweep upwards from the last
+ *                dispatched sector, wrapping to the lowest one.
+ *   INPUTS: blk_queue_t* q - queue, locked
+ *   OUTPUTS: none
+ *   RETURN VALUE: request removed from the queue, NULL if it is empty
+ */
+static blk_req_t*
+deadline_next(blk_queue_t* q)
+{
+	blk_req_t* req = NULL;
+	uint32_t now = rdtsc();
+	uint32_t dir;
+
+	for (dir = 0; dir < BLK_DIRS && req == NULL; dir++) {
+		if (q->fifo_head[dir] != NULL && (int32_t)(now - q->fifo_head[dir]->deadline) >= 0) {
+			req = q->fifo_head[dir];
+			q->stats.expired++;
+		}
+	}
+
+	if (req == NULL) {
+		for (req = q->head; req != NULL && req->sector < q->next_sector; req = req->next);
+		if (req == NULL)
+			req = q->head;
+		if (req == NULL)
+			return NULL;
+	}
+
+	list_remove(q, req);
+	if (req->fifo_prev != NULL)
+		req->fifo_prev->fifo_next = req->fifo_next;
+	else
+		q->fifo_head[req->dir] = req->fifo_next;
+	if (req->fifo_next != NULL)
+		req->fifo_next->fifo_prev = req->fifo_prev;
+	else
+		q->fifo_tail[req->dir] = req->fifo_prev;
+
+	return req;
+}
+
+elevator_t deadline_elevator = {
+	.name = "deadline",
+	.merge = deadline_merge,
+	.add = deadline_add,
+	.next = deadline_next,
+};
@@ -0,0 +1,28 @@
+/* iosched.h - I/O schedulers ordering block requests for a device
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IOSCHED_H
+#define _IOSCHED_H
+
+#include "types.h"
+#include "blkdev.h"
+
+/* Longest a request waits before the deadline scheduler dispatches it out
+ * of sector order, in TSC cycles (about 25ms and 250ms at 2GHz) */
+#define READ_EXPIRE		50000000
+#define WRITE_EXPIRE	500000000
+
+/* Dispatch in arrival order, merging only into the newest request */
+extern elevator_t noop_elevator;
+/* Sweep by sector, but serve requests whose deadline passed first */
+extern elevator_t deadline_elevator;
+
+#define DEFAULT_ELEVATOR deadline_elevator
+
+/* Scheduler by name, NULL if there is none */
+elevator_t* elevator_find(const int8_t* name);
+/* Add a block to a request if it extends it at either end */
+int32_t req_merge(blk_req_t* req, struct buf_head_t* bh, uint32_t dir);
+
+#endif /* _IOSCHED_H */
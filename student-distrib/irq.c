@@ -0,0 +1,201 @@
+/* irq.c - Interrupt controller selection and generic IRQ masking
+ * vim:ts=4 noexpandtab
+ */
+
+#include "irq.h"
+#include "i8259.h"
+#include "ioapic.h"
+#include "apic.h"
+#include "smp.h"
+#include "lib.h"
+
+/* Interrupt mode configuration register, connects the 8259 to either the
+ * boot processor's INTR pin or the APIC bus */
+#define IMCR_ADDR_PORT	0x22
+#define IMCR_DATA_PORT	0x23
+#define IMCR_SELECT		0x70
+#define IMCR_APIC		0x01
+
+irq_chip_t* irq_chip = &i8259_chip;
+
+/* Handler chains, entries come from a fixed pool */
+static irq_action_t* irq_actions[NUM_ISA_IRQS];
+static irq_action_t action_pool[MAX_IRQ_ACTIONS];
+static spinlock_t action_lock = SPIN_LOCK_UNLOCKED;
+
+/* Interrupts taken on each line, and those no handler claimed */
+uint32_t irq_count[NUM_ISA_IRQS];
+uint32_t irq_unhandled[NUM_ISA_IRQS];
+
+/*
+ * irq_init
+ *   DESCRIPTION: Moves IRQ delivery from the 8259 to the IOAPIC when the
+ *                MP table described one and the local APIC is enabled.
+ *                The 8259 is left initialized but fully masked so it
+ *                stays usable as the fallback.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: IRQs enabled on the old controller are enabled on the new
+ */
+void
+irq_init(void)
+{
+	uint32_t flags;
+	uint32_t i, enabled;
+
+	if (lapic == NULL || ioapic_init() == -1)
+		return;
+
+	cli_and_save(flags);
+	enabled = i8259_enabled();
+	i8259_mask_all();
+	if (mp_imcr_present) {
+		outb(IMCR_SELECT, IMCR_ADDR_PORT);
+		outb(IMCR_APIC, IMCR_DATA_PORT);
+	}
+	irq_chip = &ioapic_chip;
+	for (i = 0; i < NUM_ISA_IRQS; i++) {
+		if (enabled & (1 << i))
+			enable_irq(i);
+	}
+	restore_flags(flags);
+
+	printf("IRQ: routed through %s\n", irq_chip->name);
+}
+
+/* Enable (unmask) the specified IRQ */
+void
+enable_irq(uint32_t irq_num)
+{
+	if (irq_num < NUM_ISA_IRQS)
+		irq_chip->enable(irq_num);
+}
+
+/* Disable (mask) the specified IRQ */
+void
+disable_irq(uint32_t irq_num)
+{
+	if (irq_num < NUM_ISA_IRQS)
+		irq_chip->disable(irq_num);
+}
+
+/* Deliver the specified IRQ to one CPU only */
+int32_t
+irq_set_affinity(uint32_t irq_num, uint32_t cpu)
+{
+	if (irq_num >= NUM_ISA_IRQS)
+		return -1;
+
+	return irq_chip->set_affinity(irq_num, cpu);
+}
+
+/*
+ * request_irq
+ *   DESCRIPTION: Adds a handler to the end of an IRQ line's chain. Every
+ *                handler on a shared line is called for each interrupt
+ *                and returns IRQ_NONE when its device did not raise it.
+ *   INPUTS: uint32_t irq_num - IRQ line
+ *           irq_handler_t handler - called with interrupts disabled
+ *           void* ctx - passed to handler
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a bad line or a full pool
+ */
+int32_t
+request_irq(uint32_t irq_num, irq_handler_t handler, void* ctx)
+{
+	uint32_t flags;
+	uint32_t i;
+	irq_action_t* action = NULL;
+	irq_action_t** link;
+
+	if (irq_num >= NUM_ISA_IRQS || handler == NULL)
+		return -1;
+
+	spin_lock_irqsave(&action_lock, flags);
+	for (i = 0; i < MAX_IRQ_ACTIONS; i++) {
+		if (action_pool[i].handler == NULL) {
+			action = &action_pool[i];
+			break;
+		}
+	}
+	if (action == NULL) {
+		spin_unlock_irqrestore(&action_lock, flags);
+		return -1;
+	}
+
+	action->handler = handler;
+	action->ctx = ctx;
+	action->next = NULL;
+
+	/* Link in last, the entry is complete before do_irq can see it */
+	for (link = &irq_actions[irq_num]; *link != NULL; link = &(*link)->next);
+	*link = action;
+	spin_unlock_irqrestore(&action_lock, flags);
+
+	return 0;
+}
+
+/*
+ * free_irq
+ *   DESCRIPTION: Removes a handler added by request_irq. The line is left
+ *                unmasked; the caller masks it if it has no users left.
+ *   INPUTS: uint32_t irq_num - IRQ line
+ *           irq_handler_t handler, void* ctx - as passed to request_irq
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if no such handler is registered
+ */
+int32_t
+free_irq(uint32_t irq_num, irq_handler_t handler, void* ctx)
+{
+	uint32_t flags;
+	irq_action_t** link;
+	irq_action_t* action;
+
+	if (irq_num >= NUM_ISA_IRQS)
+		return -1;
+
+	spin_lock_irqsave(&action_lock, flags);
+	for (link = &irq_actions[irq_num]; *link != NULL; link = &(*link)->next) {
+		action = *link;
+		if (action->handler == handler && action->ctx == ctx) {
+			*link = action->next;
+			action->handler = NULL;
+			spin_unlock_irqrestore(&action_lock, flags);
+			return 0;
+		}
+	}
+	spin_unlock_irqrestore(&action_lock, flags);
+
+	return -1;
+}
+
+/*
+ * do_irq
+ *   DESCRIPTION: Calls each handler chained on an IRQ line, then sends the
+ *                end of interrupt
+ *   INPUTS: uint32_t irq_num - IRQ line that fired
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+do_irq(uint32_t irq_num)
+{
+	irq_action_t* action;
+	irq_handler_t handler;
+	int32_t handled = IRQ_NONE;
+
+	irq_count[irq_num]++;
+
+	for (action = irq_actions[irq_num]; action != NULL; action = action->next) {
+		/* Cleared by a free_irq racing on another CPU */
+		handler = action->handler;
+		if (handler != NULL)
+			handled |= handler(irq_num, action->ctx);
+	}
+
+	if (handled == IRQ_NONE)
+		irq_unhandled[irq_num]++;
+
+	send_eoi(irq_num);
+}
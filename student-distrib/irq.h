@@ -0,0 +1,65 @@
+/* irq.h - Interrupt controller abstraction over the 8259 pair and the
+ * IOAPIC + local APIC
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _IRQ_H
+#define _IRQ_H
+
+#include "types.h"
+
+#define NUM_ISA_IRQS 16
+#define IRQ_VECTOR_BASE 0x20	// Vector of IRQ 0 on either controller
+#define MAX_IRQ_ACTIONS 32		// Handlers registered across all lines
+
+/* Return values of an IRQ handler */
+#define IRQ_NONE 0				// Device on a shared line was not the source
+#define IRQ_HANDLED 1
+
+/* Handler registered with request_irq, ctx is passed back unchanged */
+typedef int32_t (*irq_handler_t)(uint32_t irq_num, void* ctx);
+
+/* One handler on an IRQ line; lines shared by several devices chain them */
+typedef struct irq_action_t {
+	irq_handler_t handler;
+	void* ctx;
+	struct irq_action_t* next;
+} irq_action_t;
+
+/* Operations of one interrupt controller backend */
+typedef struct irq_chip_t {
+	const char* name;
+	void (*enable)(uint32_t irq_num);
+	void (*disable)(uint32_t irq_num);
+	void (*eoi)(uint32_t irq_num);
+	/* Route an IRQ to one CPU, -1 if the controller cannot */
+	int32_t (*set_affinity)(uint32_t irq_num, uint32_t cpu);
+} irq_chip_t;
+
+/* Backend in use, the 8259 until irq_init finds an IOAPIC */
+extern irq_chip_t* irq_chip;
+
+/* Switch to the IOAPIC if the MP table listed one */
+void irq_init(void);
+
+/* Add a handler to an IRQ line, the caller unmasks it with enable_irq */
+int32_t request_irq(uint32_t irq_num, irq_handler_t handler, void* ctx);
+/* Remove a handler added by request_irq */
+int32_t free_irq(uint32_t irq_num, irq_handler_t handler, void* ctx);
+/* Run every handler of an IRQ line and acknowledge it */
+void do_irq(uint32_t irq_num);
+
+/* Enable (unmask) the specified IRQ */
+void enable_irq(uint32_t irq_num);
+/* Disable (mask) the specified IRQ */
+void disable_irq(uint32_t irq_num);
+/* Deliver the specified IRQ to one CPU only */
+int32_t irq_set_affinity(uint32_t irq_num, uint32_t cpu);
+
+/* Send end-of-interrupt signal for the specified IRQ */
+static inline void send_eoi(uint32_t irq_num)
+{
+	irq_chip->eoi(irq_num);
+}
+
+#endif /* _IRQ_H */
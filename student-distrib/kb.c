@@ -1,4 +1,5 @@
 #include "kb.h"
+#include "syscall.h"
 
 //scancode to key mappings based on special key presses
 
@@ -23,6 +24,34 @@ int i;
 int32_t keyboard_buffer[BUFFER_SIZE];
 int read_flag, enter_flag, clear_flag, to_read = 0;
 
+/* Readers and pollers waiting for Enter */
+static wait_queue_t term_wq = WAIT_QUEUE_INIT;
+
+/* Start collecting a line of up to nbytes, echoing keys as they are typed */
+static void term_start_line (int32_t nbytes) {
+	for (i = 0; i < BUFFER_SIZE; i++)
+		keyboard_buffer[i] = '\0';
+
+	read_flag = 1;
+	enter_flag = 0;
+	to_read = nbytes;
+}
+
+/* stdin can be read once Enter ends a line. Polling starts collecting the
+ * line if no read has yet, so keys typed meanwhile are not dropped. */
+uint32_t term_poll (int32_t fd, poll_table_t* pt) {
+	poll_wait(&term_wq, pt);
+
+	if (!read_flag)
+		term_start_line(BUFFER_SIZE);
+	return enter_flag ? POLLIN : 0;
+}
+
+/* The screen always takes output */
+uint32_t term_write_poll (int32_t fd, poll_table_t* pt) {
+	return POLLOUT;
+}
+
 int32_t term_open (int32_t fd) {
 	clear();
 
@@ -44,21 +73,22 @@ int32_t term_close (int32_t fd) {
 
 int32_t term_read (int32_t fd, void* buf, int32_t nbytes) {
 	int num_bytes_read = 0;
+	int32_t ret;
 	unsigned char * charbuf = (unsigned char *) buf;
 
 	if (buf == NULL || nbytes < 0 || nbytes > 1024)
 		return -1;
 		
-	//initialize keyboard buffer
-	for (i = 0; i < BUFFER_SIZE; i++)
-		keyboard_buffer[i] = '\0';
-		
-	read_flag = 1;
-	enter_flag=0;
+	//a poll may already have started the line
+	if (!read_flag)
+		term_start_line(nbytes);
 	
-	to_read = nbytes;
-	//keep waiting if enter not pressed 
-	while (enter_flag == 0);
+	//sleep until enter is pressed, a non-blocking read keeps the line going
+	if ((ret = wait_ready(fd, term_poll, POLLIN)) != 0) {
+		if (ret != -EAGAIN)
+			read_flag = 0;
+		return ret;
+	}
 
 	//initialize charbuf
 	for (i = 0; i < nbytes; i++)
@@ -79,7 +109,7 @@ int32_t term_write (int32_t fd, const void* buf, int32_t nbytes) {
 	int num_bytes_written = 0;
 	unsigned char * charbuf = (unsigned char *) buf;
 
-	if (charbuf == NULL || nbytes < 0 || nbytes > 128)
+	if (charbuf == NULL || nbytes < 0 || nbytes > TERM_WRITE_MAX)
 		return -1;
 
 	for (i = 0; i < nbytes; i++) {
@@ -94,10 +124,63 @@ int32_t term_write (int32_t fd, const void* buf, int32_t nbytes) {
 	return num_bytes_written;
 }
 
-void kb_handler() {
+/* Writes every segment, then moves the cursor once at the end. Each
+ * segment has the same limit as a term_write. */
+int32_t term_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+	int32_t seg, num_bytes_written = 0;
+	uint8_t* charbuf;
+
+	for (seg = 0; seg < iovcnt; seg++) {
+		if (iov[seg].base == NULL || iov[seg].len > TERM_WRITE_MAX)
+			return -1;
+	}
+
+	for (seg = 0; seg < iovcnt; seg++) {
+		charbuf = (uint8_t*)iov[seg].base;
+		for (i = 0; i < iov[seg].len; i++)
+			putc(charbuf[i]);
+		num_bytes_written += iov[seg].len;
+	}
+	
+	update_screen_loc(get_screen_x(), get_screen_y());
+	
+	char_num=0;
+	
+	return num_bytes_written;
+}
+
+/* Scancodes read by the interrupt handler, waiting for kb_tasklet. Single
+ * producer (the IRQ) and single consumer (the tasklet on the same CPU). */
+static uint8_t scancode_ring[SCANCODE_RING_SIZE];
+static volatile uint32_t scancode_head, scancode_tail;
+static void kb_bottom_half(void* data);
+tasklet_t kb_tasklet = TASKLET_INIT("keyboard", kb_bottom_half, NULL);
+
+/* Register the keyboard interrupt handler, term_open unmasks the line */
+void initialize_keyboard() {
+	request_irq(KEYBOARD_IRQ_NUM, kb_handler, NULL);
+}
+
+/* Only captures the scancode, echo and scrolling run in kb_bottom_half */
+int32_t kb_handler(uint32_t irq_num, void* ctx) {
 	unsigned char scancode = inb(IO_DATA_PORT);
-	handle_scancode(scancode);
-	send_eoi(KEYBOARD_IRQ_NUM);
+
+	/* Drop keys when the bottom half has fallen a whole ring behind */
+	if (scancode_head - scancode_tail < SCANCODE_RING_SIZE) {
+		scancode_ring[scancode_head % SCANCODE_RING_SIZE] = scancode;
+		scancode_head++;
+	}
+	tasklet_schedule(&kb_tasklet);
+
+	return IRQ_HANDLED;
+}
+
+/* Processes captured scancodes with interrupts enabled */
+static void kb_bottom_half(void* data) {
+	while (scancode_tail != scancode_head) {
+		handle_scancode(scancode_ring[scancode_tail % SCANCODE_RING_SIZE]);
+		scancode_tail++;
+	}
 }
 
 void set_fn_flags(unsigned char scancode) {
@@ -142,6 +225,14 @@ void handle_scancode(unsigned char scancode) {
 	uint8_t key;
 	
 	set_fn_flags(scancode);
+
+	/* Ctrl+C interrupts the foreground program. The first shell is left
+	 * alone: killing it, or failing its read, would shut down the OS. */
+	if (ctrl_pressed && (scancode == SCANCODE_C)) {
+		if (foreground_pcb != NULL && foreground_pcb->pid != 0)
+			send_signal(foreground_pcb, SIG_INTERRUPT);
+		return;
+	}
 	
 	if(!read_flag) return;
 	
@@ -209,5 +300,8 @@ void move_to_buffer(unsigned char scancode, uint8_t key) {
 			putc(key);
 			char_num++;
 		}
+		
+		if (key == '\n' && enter_flag)
+			wake_up(&term_wq);
 	}
 }
@@ -6,12 +6,16 @@
 
 #include "types.h"
 #include "lib.h"
-#include "i8259.h"
+#include "irq.h"
+#include "softirq.h"
+#include "sched.h"
 
 #define IO_DATA_PORT 0x60
 #define KEYBOARD_IRQ_NUM 1
 
 #define BUFFER_SIZE 128
+#define TERM_WRITE_MAX 4096	// Largest write (or writev segment) to the terminal
+#define SCANCODE_RING_SIZE 64	// Scancodes held for the bottom half (power of 2)
 
 //scancodes for special keys
 #define CTRL_MAKE 0x1D
@@ -37,22 +41,30 @@
 #define SCANCODE_FORWARD_SLASH 0x35
 #define SCANCODE_SPACE 0x39
 #define SCANCODE_L 0x26
+#define SCANCODE_C 0x2E
 
 #define NUM_KEYS 58
 
+struct iovec_t;
+
 extern int32_t keyboard_buffer[BUFFER_SIZE];
+extern tasklet_t kb_tasklet;
 
 //flags for special keys
 volatile uint32_t backspace_pressed, ctrl_pressed;
 volatile uint32_t shift_pressed, capslock_pressed, enter_pressed;
 
-void kb_handler();
+void initialize_keyboard();
+int32_t kb_handler(uint32_t irq_num, void* ctx);
 
 //terminal system call functions
 int32_t term_read (int32_t fd, void* buf, int32_t nbytes);
 int32_t term_write (int32_t fd, const void* buf, int32_t nbytes);
+int32_t term_writev (int32_t fd, const struct iovec_t* iov, int32_t iovcnt);
 int32_t term_open (int32_t fd);
 int32_t term_close (int32_t fd);
+uint32_t term_poll (int32_t fd, poll_table_t* pt);
+uint32_t term_write_poll (int32_t fd, poll_table_t* pt);
 
 //secondary helper functions
 void set_fn_flags(unsigned char scancode);
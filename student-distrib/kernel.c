@@ -6,6 +6,7 @@
 #include "x86_desc.h"
 #include "lib.h"
 #include "i8259.h"
+#include "irq.h"
 #include "debug.h"
 
 #include "kb.h"
@@ -14,6 +15,10 @@
 #include "idt.h"
 #include "page_init.h"
 #include "syscall.h"
+#include "smp.h"
+#include "fpu.h"
+#include "membench.h"
+#include "ata.h"
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
@@ -61,7 +66,8 @@ entry (unsigned long magic, unsigned long addr)
 		module_t* mod = (module_t*)mbi->mods_addr;
 		
 		/* Assign pointer of file system module to global variable */
-		fs_boot = (boot_block_t*) mod->mod_start;
+		fs_module = (boot_block_t*) mod->mod_start;
+		fs_boot = fs_module;
 		
 		while(mod_count < mbi->mods_count) {
 			printf("Module %d loaded at address: 0x%#x\n", mod_count, (unsigned int)mod->mod_start);
@@ -225,11 +231,31 @@ entry (unsigned long magic, unsigned long addr)
 	/* Init paging*/
 	page_init();
 
+	/* Start the other processors */
+	smp_init();
+
+	/* Enable the FPU and SSE, loaded lazily per process */
+	fpu_init();
+	mem_select();
+
+#ifdef MEM_BENCH
+	/* Check and time the memcpy/memset variants */
+	mem_bench();
+#endif
+
+	/* Route IRQs through the IOAPIC when there is one */
+	irq_init();
+
 	/* Init the keyboard driver */
-	//initialize_keyboard();
+	initialize_keyboard();
 
 	/* Init the RTC driver */
 	initialize_rtc();
+
+	/* Find IDE disks and read the file system from one if it has it */
+	bcache_init();
+	ata_init();
+	fs_mount();
 	
 	sti();
 /*	
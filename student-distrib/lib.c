@@ -3,6 +3,7 @@
  */
 
 #include "lib.h"
+#include "fpu.h"
 #define VIDEO 0xB8000
 #define NUM_COLS 80
 #define NUM_ROWS 25
@@ -385,25 +386,35 @@ strrev(int8_t* s)
 uint32_t
 strlen(const int8_t* s)
 {
-	register uint32_t len = 0;
-	while(s[len] != '\0')
-		len++;
+	const int8_t* p = s;
+	const uint32_t* w;
 
-	return len;
+	/* Bytes up to a word boundary; aligned words never cross a page */
+	for (; (uint32_t)p & WORD_MASK; p++)
+		if (*p == '\0')
+			return p - s;
+
+	for (w = (const uint32_t*)p; !HAS_ZERO_BYTE(*w); w++);
+
+	for (p = (const int8_t*)w; *p != '\0'; p++);
+	return p - s;
 }
 
 /*
-* void* memset(void* s, int32_t c, uint32_t n);
+* void* memset_stosl(void* s, int32_t c, uint32_t n);
 *   Inputs: void* s = pointer to memory
 *			int32_t c = value to set memory to
 *			uint32_t n = number of bytes to set
 *   Return Value: new string
-*	Function: set n consecutive bytes of pointer s to value c
+*	Function: set n consecutive bytes of pointer s to value c, with
+*			  rep stosl between byte stores up to alignment
 */
 
 void*
-memset(void* s, int32_t c, uint32_t n)
+memset_stosl(void* s, int32_t c, uint32_t n)
 {
+	uint32_t d0, d1;
+
 	c &= 0xFF;
 	asm volatile("                  \n\
 			.memset_top:            \n\
@@ -432,8 +443,8 @@ memset(void* s, int32_t c, uint32_t n)
 			jmp     .memset_bottom  \n\
 			.memset_done:           \n\
 			"
-			:
-			: "a"(c << 24 | c << 16 | c << 8 | c), "D"(s), "c"(n)
+			: "=&D"(d0), "=&c"(d1)
+			: "a"(c << 24 | c << 16 | c << 8 | c), "0"(s), "1"(n)
 			: "edx", "memory", "cc"
 			);
 
@@ -453,14 +464,16 @@ memset(void* s, int32_t c, uint32_t n)
 void*
 memset_word(void* s, int32_t c, uint32_t n)
 {
+	uint32_t d0, d1;
+
 	asm volatile("                  \n\
 			movw    %%ds, %%dx      \n\
 			movw    %%dx, %%es      \n\
 			cld                     \n\
 			rep     stosw           \n\
 			"
-			:
-			: "a"(c), "D"(s), "c"(n)
+			: "=&D"(d0), "=&c"(d1)
+			: "a"(c), "0"(s), "1"(n)
 			: "edx", "memory", "cc"
 			);
 
@@ -479,14 +492,16 @@ memset_word(void* s, int32_t c, uint32_t n)
 void*
 memset_dword(void* s, int32_t c, uint32_t n)
 {
+	uint32_t d0, d1;
+
 	asm volatile("                  \n\
 			movw    %%ds, %%dx      \n\
 			movw    %%dx, %%es      \n\
 			cld                     \n\
 			rep     stosl           \n\
 			"
-			:
-			: "a"(c), "D"(s), "c"(n)
+			: "=&D"(d0), "=&c"(d1)
+			: "a"(c), "0"(s), "1"(n)
 			: "edx", "memory", "cc"
 			);
 
@@ -494,17 +509,20 @@ memset_dword(void* s, int32_t c, uint32_t n)
 }
 
 /*
-* void* memcpy(void* dest, const void* src, uint32_t n);
+* void* memcpy_movsl(void* dest, const void* src, uint32_t n);
 *   Inputs: void* dest = destination of copy
 *			const void* src = source of copy
 *			uint32_t n = number of byets to copy
 *   Return Value: pointer to dest
-*	Function: copy n bytes of src to dest
+*	Function: copy n bytes of src to dest, with rep movsl between byte
+*			  copies up to alignment
 */
 
 void*
-memcpy(void* dest, const void* src, uint32_t n)
+memcpy_movsl(void* dest, const void* src, uint32_t n)
 {
+	uint32_t d0, d1, d2;
+
 	asm volatile("                  \n\
 			.memcpy_top:            \n\
 			testl   %%ecx, %%ecx    \n\
@@ -536,14 +554,270 @@ memcpy(void* dest, const void* src, uint32_t n)
 			jmp     .memcpy_bottom  \n\
 			.memcpy_done:           \n\
 			"
-			:
-			: "S"(src), "D"(dest), "c"(n)
+			: "=&S"(d0), "=&D"(d1), "=&c"(d2)
+			: "0"(src), "1"(dest), "2"(n)
 			: "eax", "edx", "memory", "cc"
 			);
 
 	return dest;
 }
 
+/*
+* void* memset_ermsb(void* s, int32_t c, uint32_t n);
+*   Inputs: void* s = pointer to memory
+*			int32_t c = value to set memory to
+*			uint32_t n = number of bytes to set
+*   Return Value: pointer to s
+*	Function: set n bytes with a single rep stosb, fast on CPUs with ERMSB
+*/
+
+void*
+memset_ermsb(void* s, int32_t c, uint32_t n)
+{
+	uint32_t d0, d1;
+
+	asm volatile("                  \n\
+			movw    %%ds, %%dx      \n\
+			movw    %%dx, %%es      \n\
+			cld                     \n\
+			rep     stosb           \n\
+			"
+			: "=&D"(d0), "=&c"(d1)
+			: "a"(c), "0"(s), "1"(n)
+			: "edx", "memory", "cc"
+			);
+
+	return s;
+}
+
+/*
+* void* memset_sse2(void* s, int32_t c, uint32_t n);
+*   Inputs: void* s = pointer to memory
+*			int32_t c = value to set memory to
+*			uint32_t n = number of bytes to set
+*   Return Value: pointer to s
+*	Function: set n bytes with 16-byte non-temporal stores, which bypass
+*			  the cache; meant for whole pages and larger. Works in
+*			  SSE_CHUNK pieces, restoring the caller's interrupt state
+*			  between them.
+*/
+
+void*
+memset_sse2(void* s, int32_t c, uint32_t n)
+{
+	uint8_t* d = (uint8_t*)s;
+	uint32_t head, blocks, chunk, flags;
+
+	if (n < SSE_MIN_SIZE)
+		return memset_stosl(s, c, n);
+
+	c &= 0xFF;
+	c |= c << 8;
+	c |= c << 16;
+
+	/* Align the destination for movntdq */
+	head = (-(uint32_t)d) & (SSE_ALIGN - 1);
+	memset_stosl(d, c, head);
+	d += head;
+	n -= head;
+	blocks = n / SSE_BLOCK;
+
+	/* The FPU is borrowed with interrupts off, so give them a window
+	 * between chunks rather than holding them off for the whole fill */
+	while (blocks > 0) {
+		chunk = (blocks < SSE_CHUNK / SSE_BLOCK) ? blocks : SSE_CHUNK / SSE_BLOCK;
+		blocks -= chunk;
+		flags = kernel_fpu_begin();
+		asm volatile("                  \n\
+				movd    %3, %%xmm0      \n\
+				pshufd  $0, %%xmm0, %%xmm0 \n\
+				1:                      \n\
+				movntdq %%xmm0, (%0)    \n\
+				movntdq %%xmm0, 16(%0)  \n\
+				movntdq %%xmm0, 32(%0)  \n\
+				movntdq %%xmm0, 48(%0)  \n\
+				addl    $64, %0         \n\
+				subl    $1, %1          \n\
+				jnz     1b              \n\
+				sfence                  \n\
+				"
+				: "=r"(d), "=r"(chunk)
+				: "0"(d), "r"(c), "1"(chunk)
+				: "memory", "cc"
+				);
+		kernel_fpu_end(flags);
+	}
+
+	memset_stosl(d, c, n % SSE_BLOCK);
+	return s;
+}
+
+/*
+* void* memcpy_ermsb(void* dest, const void* src, uint32_t n);
+*   Inputs: void* dest = destination of copy
+*			const void* src = source of copy
+*			uint32_t n = number of bytes to copy
+*   Return Value: pointer to dest
+*	Function: copy n bytes with a single rep movsb, fast on CPUs with ERMSB
+*/
+
+void*
+memcpy_ermsb(void* dest, const void* src, uint32_t n)
+{
+	uint32_t d0, d1, d2;
+
+	asm volatile("                  \n\
+			movw    %%ds, %%dx      \n\
+			movw    %%dx, %%es      \n\
+			cld                     \n\
+			rep     movsb           \n\
+			"
+			: "=&S"(d0), "=&D"(d1), "=&c"(d2)
+			: "0"(src), "1"(dest), "2"(n)
+			: "edx", "memory", "cc"
+			);
+
+	return dest;
+}
+
+/*
+* void* memcpy_sse2(void* dest, const void* src, uint32_t n);
+*   Inputs: void* dest = destination of copy
+*			const void* src = source of copy
+*			uint32_t n = number of bytes to copy
+*   Return Value: pointer to dest
+*	Function: copy n bytes 64 at a time with unaligned 16-byte loads and
+*			  non-temporal stores; meant for whole pages and larger. Works
+*			  in SSE_CHUNK pieces like memset_sse2.
+*/
+
+void*
+memcpy_sse2(void* dest, const void* src, uint32_t n)
+{
+	uint8_t* d = (uint8_t*)dest;
+	const uint8_t* s = (const uint8_t*)src;
+	uint32_t head, blocks, chunk, flags;
+
+	if (n < SSE_MIN_SIZE)
+		return memcpy_movsl(dest, src, n);
+
+	/* Align the destination for movntdq */
+	head = (-(uint32_t)d) & (SSE_ALIGN - 1);
+	memcpy_movsl(d, s, head);
+	d += head;
+	s += head;
+	n -= head;
+	blocks = n / SSE_BLOCK;
+
+	/* As in memset_sse2, interrupts get a window between chunks */
+	while (blocks > 0) {
+		chunk = (blocks < SSE_CHUNK / SSE_BLOCK) ? blocks : SSE_CHUNK / SSE_BLOCK;
+		blocks -= chunk;
+		flags = kernel_fpu_begin();
+		asm volatile("                  \n\
+				1:                      \n\
+				movdqu  (%1), %%xmm0    \n\
+				movdqu  16(%1), %%xmm1  \n\
+				movdqu  32(%1), %%xmm2  \n\
+				movdqu  48(%1), %%xmm3  \n\
+				movntdq %%xmm0, (%0)    \n\
+				movntdq %%xmm1, 16(%0)  \n\
+				movntdq %%xmm2, 32(%0)  \n\
+				movntdq %%xmm3, 48(%0)  \n\
+				addl    $64, %1         \n\
+				addl    $64, %0         \n\
+				subl    $1, %2          \n\
+				jnz     1b              \n\
+				sfence                  \n\
+				"
+				: "=r"(d), "=r"(s), "=r"(chunk)
+				: "0"(d), "1"(s), "2"(chunk)
+				: "memory", "cc"
+				);
+		kernel_fpu_end(flags);
+	}
+
+	memcpy_movsl(d, s, n % SSE_BLOCK);
+	return dest;
+}
+
+/* Variants picked by mem_select, the rep movsl/stosl ones until then */
+static void* (*memcpy_fn)(void*, const void*, uint32_t) = memcpy_movsl;
+static void* (*memcpy_large_fn)(void*, const void*, uint32_t) = memcpy_movsl;
+static void* (*memset_fn)(void*, int32_t, uint32_t) = memset_stosl;
+static void* (*memset_large_fn)(void*, int32_t, uint32_t) = memset_stosl;
+
+/*
+* void mem_select(void)
+*   Inputs: none
+*   Return Value: none
+*	Function: picks memcpy/memset variants from the CPUID feature bits:
+*			  rep movsb/stosb with ERMSB, and non-temporal SSE2 stores
+*			  for copies and fills of MEM_LARGE_SIZE and up within
+*			  kernel memory; user buffers keep the rep variants. Called once
+*			  fpu_init has enabled SSE.
+*/
+
+void
+mem_select(void)
+{
+	uint32_t eax, ebx, ecx, edx;
+	uint32_t max_leaf;
+
+	cpuid(CPUID_VENDOR, 0, &max_leaf, &ebx, &ecx, &edx);
+	cpuid(CPUID_FEATURES, 0, &eax, &ebx, &ecx, &edx);
+	if (edx & CPUID_EDX_SSE2) {
+		memcpy_large_fn = memcpy_sse2;
+		memset_large_fn = memset_sse2;
+	}
+
+	if (max_leaf >= CPUID_EXT_FEATURES) {
+		cpuid(CPUID_EXT_FEATURES, 0, &eax, &ebx, &ecx, &edx);
+		if (ebx & CPUID_EBX_ERMSB) {
+			memcpy_fn = memcpy_ermsb;
+			memset_fn = memset_ermsb;
+			if (!(edx & CPUID_EDX_SSE2)) {
+				memcpy_large_fn = memcpy_ermsb;
+				memset_large_fn = memset_ermsb;
+			}
+		}
+	}
+}
+
+/*
+* void* memset(void* s, int32_t c, uint32_t n);
+*   Inputs: void* s = pointer to memory
+*			int32_t c = value to set memory to
+*			uint32_t n = number of bytes to set
+*   Return Value: pointer to s
+*	Function: set n consecutive bytes of pointer s to value c
+*/
+
+void*
+memset(void* s, int32_t c, uint32_t n)
+{
+	if (n >= MEM_LARGE_SIZE && KERNEL_RANGE(s, n))
+		return memset_large_fn(s, c, n);
+	return memset_fn(s, c, n);
+}
+
+/*
+* void* memcpy(void* dest, const void* src, uint32_t n);
+*   Inputs: void* dest = destination of copy
+*			const void* src = source of copy
+*			uint32_t n = number of byets to copy
+*   Return Value: pointer to dest
+*	Function: copy n bytes of src to dest
+*/
+
+void*
+memcpy(void* dest, const void* src, uint32_t n)
+{
+	if (n >= MEM_LARGE_SIZE && KERNEL_RANGE(dest, n) && KERNEL_RANGE(src, n))
+		return memcpy_large_fn(dest, src, n);
+	return memcpy_fn(dest, src, n);
+}
+
 /*
 * void* memmove(void* dest, const void* src, uint32_t n);
 *   Inputs: void* dest = destination of move
@@ -557,20 +831,25 @@ memcpy(void* dest, const void* src, uint32_t n)
 void*
 memmove(void* dest, const void* src, uint32_t n)
 {
+	uint32_t d0, d1, d2;
+
+	/* Every memcpy variant copies forward and reads each block before
+	 * storing it, so only a destination above an overlapping source
+	 * needs the backward copy */
+	if (dest <= src || (uint8_t*)dest >= (uint8_t*)src + n)
+		return memcpy(dest, src, n);
+
 	asm volatile("                  \n\
 			movw    %%ds, %%dx      \n\
 			movw    %%dx, %%es      \n\
-			cld                     \n\
-			cmp     %%edi, %%esi    \n\
-			jae     .memmove_go     \n\
 			leal    -1(%%esi, %%ecx), %%esi    \n\
 			leal    -1(%%edi, %%ecx), %%edi    \n\
 			std                     \n\
-			.memmove_go:            \n\
 			rep     movsb           \n\
+			cld                     \n\
 			"
-			:
-			: "D"(dest), "S"(src), "c"(n)
+			: "=&D"(d0), "=&S"(d1), "=&c"(d2)
+			: "0"(dest), "1"(src), "2"(n)
 			: "edx", "memory", "cc"
 			);
 
@@ -594,8 +873,24 @@ memmove(void* dest, const void* src, uint32_t n)
 int32_t
 strncmp(const int8_t* s1, const int8_t* s2, uint32_t n)
 {
-	int32_t i;
-	for(i=0; i<n; i++) {
+	uint32_t i = 0;
+	uint32_t w;
+
+	/* Equally aligned strings compare a word at a time until a word
+	 * differs or holds the terminator, the bytes loop finds which */
+	if ((((uint32_t)s1 ^ (uint32_t)s2) & WORD_MASK) == 0) {
+		for (; i < n && (((uint32_t)s1 + i) & WORD_MASK); i++)
+			if ((s1[i] != s2[i]) || (s1[i] == '\0'))
+				return s1[i] - s2[i];
+
+		for (; n - i >= WORD_SIZE; i += WORD_SIZE) {
+			w = *(const uint32_t*)(s1 + i);
+			if (w != *(const uint32_t*)(s2 + i) || HAS_ZERO_BYTE(w))
+				break;
+		}
+	}
+
+	for(; i<n; i++) {
 		if( (s1[i] != s2[i]) ||
 				(s1[i] == '\0') /* || s2[i] == '\0' */ ) {
 
@@ -644,16 +939,31 @@ strcpy(int8_t* dest, const int8_t* src)
 int8_t*
 strncpy(int8_t* dest, const int8_t* src, uint32_t n)
 {
-	int32_t i=0;
+	uint32_t i=0;
+	uint32_t w;
+
+	/* Equally aligned: whole words until one holds the terminator */
+	if ((((uint32_t)dest ^ (uint32_t)src) & WORD_MASK) == 0) {
+		for (; i < n && (((uint32_t)src + i) & WORD_MASK) && src[i] != '\0'; i++)
+			dest[i] = src[i];
+
+		if (i < n && src[i] != '\0') {
+			for (; n - i >= WORD_SIZE; i += WORD_SIZE) {
+				w = *(const uint32_t*)(src + i);
+				if (HAS_ZERO_BYTE(w))
+					break;
+				*(uint32_t*)(dest + i) = w;
+			}
+		}
+	}
+
 	while(src[i] != '\0' && i < n) {
 		dest[i] = src[i];
 		i++;
 	}
 
-	while(i < n) {
-		dest[i] = '\0';
-		i++;
-	}
+	if (i < n)
+		memset(dest + i, '\0', n - i);
 
 	return dest;
 }
@@ -15,6 +15,12 @@ int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
+
+/* Word-at-a-time string scanning: a word holds a zero byte exactly when
+ * subtracting 1 from each byte borrows into a high bit that was clear */
+#define WORD_SIZE 4
+#define WORD_MASK (WORD_SIZE - 1)
+#define HAS_ZERO_BYTE(w) (((w) - 0x01010101) & ~(w) & 0x80808080)
 void clear(void);
 
 void update_cursor(int x, int y);
@@ -33,6 +39,26 @@ void* memset_word(void* s, int32_t c, uint32_t n);
 void* memset_dword(void* s, int32_t c, uint32_t n);
 void* memcpy(void* dest, const void* src, uint32_t n);
 void* memmove(void* dest, const void* src, uint32_t n);
+
+/* memcpy/memset variants, memcpy and memset pick one by CPU and size */
+#define MEM_LARGE_SIZE 4096		// Copies and fills from here on use non-temporal stores
+#define USER_MEM_START 0x08000000	// Memory below is the kernel's, which never page faults
+/* [p, p + n) lies in kernel memory. Only such copies may use the SSE2
+ * variants: a fault inside their kernel_fpu_begin section would run the
+ * page fault handler, and its I/O and page fills, with the FPU borrowed
+ * and interrupts off. */
+#define KERNEL_RANGE(p, n) ((uint32_t)(p) + (n) >= (uint32_t)(p) && (uint32_t)(p) + (n) <= USER_MEM_START)
+#define SSE_MIN_SIZE 256		// SSE2 variants hand smaller sizes to rep movsl/stosl
+#define SSE_ALIGN 16
+#define SSE_BLOCK 64			// Bytes moved per SSE2 loop iteration
+#define SSE_CHUNK 16384		// Bytes moved per kernel_fpu_begin section, a multiple of SSE_BLOCK
+void mem_select(void);
+void* memcpy_movsl(void* dest, const void* src, uint32_t n);
+void* memcpy_ermsb(void* dest, const void* src, uint32_t n);
+void* memcpy_sse2(void* dest, const void* src, uint32_t n);
+void* memset_stosl(void* s, int32_t c, uint32_t n);
+void* memset_ermsb(void* s, int32_t c, uint32_t n);
+void* memset_sse2(void* s, int32_t c, uint32_t n);
 int32_t strncmp(const int8_t* s1, const int8_t* s2, uint32_t n);
 int8_t* strcpy(int8_t* dest, const int8_t*src);
 int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
@@ -104,12 +130,30 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-	asm volatile("outl  %l1, (%w0)"     \
+	asm volatile("outl  %1, (%w0)"      \
 			:                           \
 			: "d" (port), "a" (data)    \
 			: "memory", "cc" );         \
 } while(0)
 
+/* Reads count two-byte words from a port into buf */
+static inline void insw(uint32_t port, void* buf, uint32_t count)
+{
+	asm volatile("cld; rep insw"
+			: "+D"(buf), "+c"(count)
+			: "d"(port)
+			: "memory" );
+}
+
+/* Writes count two-byte words from buf to a port */
+static inline void outsw(uint32_t port, const void* buf, uint32_t count)
+{
+	asm volatile("cld; rep outsw"
+			: "+S"(buf), "+c"(count)
+			: "d"(port)
+			: "memory" );
+}
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
@@ -157,4 +201,100 @@ do {                                    \
 			);                      \
 } while(0)
 
+/* Low 32 bits of the time-stamp counter, for measuring short intervals */
+static inline uint32_t rdtsc(void)
+{
+	uint32_t low, high;
+	asm volatile("rdtsc" : "=a"(low), "=d"(high));
+	return low;
+}
+
+/* CPUID leaves and feature bits */
+#define CPUID_VENDOR		0
+#define CPUID_FEATURES		1
+#define CPUID_EXT_FEATURES	7
+#define CPUID_EDX_FXSR		0x01000000
+#define CPUID_EDX_SSE		0x02000000
+#define CPUID_EDX_SSE2		0x04000000
+#define CPUID_EBX_ERMSB		0x00000200
+
+/* Execute CPUID for a leaf and subleaf */
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+		uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx)
+{
+	asm volatile("cpuid"
+			: "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+			: "0"(leaf), "2"(subleaf));
+}
+
+/* Index of the lowest clear bit in a bitmap of n bits, n if all are set.
+ * Whole words of set bits are skipped and bsf finds the bit in the rest. */
+static inline uint32_t find_first_zero(const uint32_t* map, uint32_t n)
+{
+	uint32_t i, bit;
+
+	for (i = 0; i < (n + 31) / 32; i++) {
+		if (map[i] == 0xFFFFFFFF)
+			continue;
+		asm("bsfl %1, %0" : "=r"(bit) : "r"(~map[i]));
+		bit += i * 32;
+		return (bit < n) ? bit : n;
+	}
+	return n;
+}
+
+/* Set a flag shared between processors to 1, returning its old value */
+static inline uint32_t
+test_and_set(volatile uint32_t* flag)
+{
+	uint32_t old;
+
+	asm volatile("xchgl %0, %1"
+			: "=r"(old), "+m"(*flag)
+			: "0"(1)
+			: "memory");
+	return old;
+}
+
+/* Spinlock shared between processors, 0 when free */
+typedef volatile uint32_t spinlock_t;
+#define SPIN_LOCK_UNLOCKED 0
+
+/* Acquire a spinlock, spinning (with pause) while another CPU holds it */
+#define spin_lock(lock)                 \
+do {                                    \
+	uint32_t _taken;                    \
+	while(1) {                          \
+		asm volatile("xchgl %0, %1"     \
+				: "=r"(_taken), "+m"(*(lock)) \
+				: "0"(1)                \
+				: "memory");            \
+		if(!_taken)                     \
+			break;                      \
+		while(*(lock))                  \
+			asm volatile("pause");      \
+	}                                   \
+} while(0)
+
+/* Release a spinlock */
+#define spin_unlock(lock)               \
+do {                                    \
+	asm volatile("" : : : "memory");    \
+	*(lock) = SPIN_LOCK_UNLOCKED;       \
+} while(0)
+
+/* Disable local interrupts, then acquire the lock */
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+	cli_and_save(flags);                \
+	spin_lock(lock);                    \
+} while(0)
+
+/* Release the lock, then restore local interrupts */
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                    \
+	spin_unlock(lock);                  \
+	restore_flags(flags);               \
+} while(0)
+
 #endif /* _LIB_H */
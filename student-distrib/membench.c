@@ -0,0 +1,168 @@
+/* membench.c - Boot-time correctness and throughput check of the
+ * memcpy/memset variants in lib.c, for sizes from BENCH_MIN_SIZE to 4MB.
+ * Built in with -DMEM_BENCH, by `make clean membench`.
+ * vim:ts=4 noexpandtab
+ */
+
+#include "membench.h"
+#include "lib.h"
+#include "page_init.h"
+
+typedef void* (*copy_fn_t)(void*, const void*, uint32_t);
+typedef void* (*fill_fn_t)(void*, int32_t, uint32_t);
+
+static copy_fn_t copy_fns[] = { memcpy_movsl, memcpy_ermsb, memcpy_sse2, memcpy };
+static fill_fn_t fill_fns[] = { memset_stosl, memset_ermsb, memset_sse2, memset };
+static int8_t* fn_names[] = { "movsl", "ermsb", "sse2", "auto" };
+#define NUM_VARIANTS (sizeof(fn_names) / sizeof(fn_names[0]))
+
+/* Map the last two process slots at BENCH_VIRT, or unmap them */
+static void
+bench_map(uint32_t on)
+{
+	uint32_t i, phys;
+
+	for (i = 0; i < 2; i++) {
+		phys = PROCESS_PHYS_ADDR(MAX_PROCESSES - 2 + i);
+		p_directory[(BENCH_VIRT >> PD_SHIFT) + i] = on ? (phys | P_FLAG | RW_FLAG | PD_PS_FLAG) : RW_FLAG;
+	}
+
+	asm volatile("movl %%cr3, %%eax\n\t"
+	"movl %%eax, %%cr3"
+	: /* no outputs */
+	: /* no inputs */
+	: "eax", "memory"
+	);
+}
+
+/* Copy n bytes from src + soff to dst + doff and check them and the guard byte */
+static int32_t
+check_copy(copy_fn_t fn, uint8_t* dst, uint8_t* src, uint32_t doff, uint32_t soff, uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < n + soff; i++)
+		src[i] = (uint8_t)(i * 7 + 3);
+	memset_stosl(dst, BENCH_GUARD, n + doff + (doff + n < BENCH_BUF_SIZE));
+
+	fn(dst + doff, src + soff, n);
+
+	for (i = 0; i < n; i++)
+		if (dst[doff + i] != src[soff + i])
+			return -1;
+	if (doff > 0 && dst[doff - 1] != BENCH_GUARD)
+		return -1;
+	if (doff + n < BENCH_BUF_SIZE && dst[doff + n] != BENCH_GUARD)
+		return -1;
+
+	return 0;
+}
+
+/* Fill n bytes at dst + doff and check them and the guard bytes */
+static int32_t
+check_fill(fill_fn_t fn, uint8_t* dst, uint32_t doff, uint32_t n)
+{
+	uint32_t i;
+
+	memset_stosl(dst, BENCH_GUARD, n + doff + (doff + n < BENCH_BUF_SIZE));
+
+	fn(dst + doff, 0x15A, n);
+
+	for (i = 0; i < n; i++)
+		if (dst[doff + i] != 0x5A)
+			return -1;
+	if (doff > 0 && dst[doff - 1] != BENCH_GUARD)
+		return -1;
+	if (doff + n < BENCH_BUF_SIZE && dst[doff + n] != BENCH_GUARD)
+		return -1;
+
+	return 0;
+}
+
+/* Move n bytes one byte up and down within buf and check them */
+static int32_t
+check_move(uint8_t* buf, uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i <= n; i++)
+		buf[i] = (uint8_t)(i * 7 + 3);
+	memmove(buf + 1, buf, n);
+	for (i = 0; i < n; i++)
+		if (buf[i + 1] != (uint8_t)(i * 7 + 3))
+			return -1;
+
+	memmove(buf, buf + 1, n);
+	for (i = 0; i < n; i++)
+		if (buf[i] != (uint8_t)(i * 7 + 3))
+			return -1;
+
+	return 0;
+}
+
+/* Bytes per 1000 TSC cycles */
+static uint32_t
+throughput(uint32_t bytes, uint32_t cycles)
+{
+	return (cycles / 1000 == 0) ? bytes : bytes / (cycles / 1000);
+}
+
+/*
+ * mem_bench
+ *   DESCRIPTION: For each power-of-two size from BENCH_MIN_SIZE to 4MB,
+ *                checks every memcpy and memset variant at aligned and
+ *                misaligned offsets, checks memmove on overlapping
+ *                buffers, and prints the throughput of each variant in
+ *                bytes per 1000 cycles
+ *   INPUTS: none
+ *   OUTPUTS: one line per size and kind on the screen
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: overwrites the memory of the last two process slots
+ */
+void
+mem_bench(void)
+{
+	uint8_t* src = (uint8_t*)BENCH_VIRT;
+	uint8_t* dst = (uint8_t*)(BENCH_VIRT + BENCH_BUF_SIZE);
+	uint32_t size, v, reps, r, t0, t1;
+	int32_t ok;
+
+	bench_map(1);
+	printf("mem_bench: bytes per 1000 cycles, * marks a failed check\n");
+
+	for (size = BENCH_MIN_SIZE; size <= BENCH_BUF_SIZE; size <<= 1) {
+		reps = BENCH_BYTES / size;
+
+		printf("%u B memcpy:", size);
+		for (v = 0; v < NUM_VARIANTS; v++) {
+			ok = check_copy(copy_fns[v], dst, src, 0, 0, size);
+			if (size < BENCH_BUF_SIZE)
+				ok |= check_copy(copy_fns[v], dst, src, 1, 3, size - 3);
+
+			t0 = rdtsc();
+			for (r = 0; r < reps; r++)
+				copy_fns[v](dst, src, size);
+			t1 = rdtsc();
+			printf(" %s %u%s", fn_names[v], throughput(reps * size, t1 - t0), ok ? "*" : "");
+		}
+
+		printf("\n%u B memset:", size);
+		for (v = 0; v < NUM_VARIANTS; v++) {
+			ok = check_fill(fill_fns[v], dst, 0, size);
+			if (size < BENCH_BUF_SIZE)
+				ok |= check_fill(fill_fns[v], dst, 5, size - 5);
+
+			t0 = rdtsc();
+			for (r = 0; r < reps; r++)
+				fill_fns[v](dst, 0, size);
+			t1 = rdtsc();
+			printf(" %s %u%s", fn_names[v], throughput(reps * size, t1 - t0), ok ? "*" : "");
+		}
+
+		if (size < BENCH_BUF_SIZE && check_move(dst, size) != 0)
+			printf(" memmove*");
+		printf("\n");
+	}
+
+	bench_map(0);
+}
@@ -0,0 +1,20 @@
+/* membench.h - Boot-time correctness and throughput check of the
+ * memcpy/memset variants
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _MEMBENCH_H
+#define _MEMBENCH_H
+
+#include "types.h"
+
+#define BENCH_VIRT		0x04000000	// Two 4MB scratch pages mapped here while the benchmark runs, in kernel memory so "auto" may use SSE2
+#define BENCH_BUF_SIZE	0x00400000
+#define BENCH_MIN_SIZE	16
+#define BENCH_BYTES		0x01000000	// Bytes moved per measurement, repeated over smaller sizes
+#define BENCH_GUARD		0xCC
+
+/* Run before the first process, the scratch pages are process slots */
+void mem_bench(void);
+
+#endif /* _MEMBENCH_H */
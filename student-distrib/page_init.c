@@ -1,24 +1,29 @@
 /* page_init.c - Holds function to initialize 1 page directory
-* and 1 page table upon bootup
+* and 1 page table upon bootup, plus demand paging for user heaps
 */
 
 #include "page_init.h"
 
 int p_directory[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
 int p_table[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
-int process0_dir[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
-int process1_dir[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
+int process_dir[MAX_PROCESSES][PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
 int vid_mem[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
+int heap_table[MAX_PROCESSES][PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
+int prog_table[MAX_PROCESSES][PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
+
+/* One bit per frame in the heap pool, set when allocated */
+static uint32_t frame_bitmap[HEAP_POOL_FRAMES / 32];
+static spinlock_t frame_lock = SPIN_LOCK_UNLOCKED;
 
 void page_init() {
-	int i;
+	int i, pid;
 	int start_addr;
 
 	/* Allow RW for page directory */
 	for(i=0; i < PAGE_ENTRIES; i++) {
 		p_directory[i] = RW_FLAG;
-		process0_dir[i] = RW_FLAG;
-		process1_dir[i] = RW_FLAG;
+		for(pid = 0; pid < MAX_PROCESSES; pid++)
+			process_dir[pid][i] = RW_FLAG;
 	}
 
 	/* Mapping first 4MB of memory by 4KB pages into page table */
@@ -36,29 +41,36 @@ void page_init() {
 	/* Map page table into page directory */
 	p_directory[0] = (int) p_table | P_FLAG | US_FLAG | RW_FLAG; //| G_FLAG
 	p_directory[KERNEL_ADDR >> PD_SHIFT] = KERNEL_ADDR | P_FLAG | RW_FLAG | PD_PS_FLAG | G_FLAG;
-	p_directory[PROG_VIRT_ADDR>>PD_SHIFT] = PROCESS0_PHYS_ADDR;
-	p_directory[USER_STACK>>PD_SHIFT] = PROCESS1_PHYS_ADDR;
-	process0_dir[0] = (int) p_table | P_FLAG | US_FLAG | RW_FLAG | G_FLAG;
-	process1_dir[1] = (int) p_table | P_FLAG | US_FLAG | RW_FLAG | G_FLAG; 
-
-	p_directory[PROG_VIRT_ADDR >> PD_SHIFT] = PROCESS0_PHYS_ADDR | P_FLAG | PD_PS_FLAG | RW_FLAG | G_FLAG;
+	p_directory[PROG_VIRT_ADDR >> PD_SHIFT] = PROCESS_PHYS_ADDR(0) | P_FLAG | PD_PS_FLAG | RW_FLAG | G_FLAG;
 	p_directory[VID_MEM_VIRTUAL >> PD_SHIFT] = (int) vid_mem | US_FLAG | RW_FLAG | P_FLAG;
-	
 
-	process0_dir[0] = (int) p_table | P_FLAG | US_FLAG | RW_FLAG | G_FLAG;
-	process1_dir[0] = (int) p_table | P_FLAG | US_FLAG | RW_FLAG | G_FLAG;
-	
-	/* Map process directories to shared kernel */
-	process0_dir[KERNEL_ADDR >> PD_SHIFT] = KERNEL_ADDR | P_FLAG | RW_FLAG | PD_PS_FLAG | G_FLAG;
-	process1_dir[KERNEL_ADDR >> PD_SHIFT] = KERNEL_ADDR | P_FLAG | RW_FLAG | PD_PS_FLAG | G_FLAG;
-	
-	/* Map process directories from virtual 128MB to physical 8MB and 12 MB */
-	process0_dir[PROG_VIRT_ADDR >> PD_SHIFT] = PROCESS0_PHYS_ADDR | P_FLAG | PD_PS_FLAG | RW_FLAG | US_FLAG;
-	process1_dir[PROG_VIRT_ADDR >> PD_SHIFT] = PROCESS1_PHYS_ADDR | P_FLAG | PD_PS_FLAG | RW_FLAG;
+	/* Map APIC registers uncached, identity mapped for every CPU */
+	p_directory[APIC_PAGE_ADDR >> PD_SHIFT] = APIC_PAGE_ADDR | P_FLAG | RW_FLAG | PD_PS_FLAG | PCD_FLAG;
+
+	/* Kernel-only view of process slots and heap frames, in every directory */
+	for(start_addr = PHYS_MAP_START; start_addr < PHYS_MAP_END; start_addr += PHYS_MAP_PAGE) {
+		p_directory[start_addr >> PD_SHIFT] = start_addr | P_FLAG | RW_FLAG | PD_PS_FLAG | G_FLAG;
+		for(pid = 0; pid < MAX_PROCESSES; pid++)
+			process_dir[pid][start_addr >> PD_SHIFT] = start_addr | P_FLAG | RW_FLAG | PD_PS_FLAG | G_FLAG;
+	}
+
+	for(pid = 0; pid < MAX_PROCESSES; pid++) {
+		process_dir[pid][0] = (int) p_table | P_FLAG | US_FLAG | RW_FLAG | G_FLAG;
+
+		/* Map process directories to shared kernel */
+		process_dir[pid][KERNEL_ADDR >> PD_SHIFT] = KERNEL_ADDR | P_FLAG | RW_FLAG | PD_PS_FLAG | G_FLAG;
+
+		/* Map program page table at virtual 128MB, pages are filled in by elf_fault */
+		process_dir[pid][PROG_VIRT_ADDR >> PD_SHIFT] = (int) prog_table[pid] | P_FLAG | RW_FLAG | US_FLAG;
+
+		/* Map video memory from virtual 132MB to physical 736 KB */
+		process_dir[pid][VID_MEM_VIRTUAL >> PD_SHIFT] = (int) vid_mem | US_FLAG | RW_FLAG | P_FLAG;
 
-	/* Map video memory from virtual 132MB to physical 736 KB */
-	process0_dir[VID_MEM_VIRTUAL >> PD_SHIFT] = (int) vid_mem | US_FLAG | RW_FLAG | P_FLAG;
-	process1_dir[VID_MEM_VIRTUAL >> PD_SHIFT] = (int) vid_mem | US_FLAG | RW_FLAG | P_FLAG;
+		process_dir[pid][APIC_PAGE_ADDR >> PD_SHIFT] = APIC_PAGE_ADDR | P_FLAG | RW_FLAG | PD_PS_FLAG | PCD_FLAG;
+
+		/* Map heap page table at virtual 136MB, pages are filled in on demand */
+		process_dir[pid][HEAP_VIRT_ADDR >> PD_SHIFT] = (int) heap_table[pid] | US_FLAG | RW_FLAG | P_FLAG;
+	}
 	
 	/* Enable 4MB page access */
 	asm volatile("movl %%cr4, %%eax\n\t"
@@ -76,7 +88,8 @@ void page_init() {
 	: "r" (p_directory) /* inputs */
 	);
 
-	/* Enable paging by setting PG and PE flags in CR0 */
+	/* Enable paging by setting PG and PE flags in CR0, WP so the kernel
+	 * cannot write through a shared read-only user page */
 	asm volatile("movl %%cr0, %%eax\n\t"
 	"movl %0, %%ebx\n\t"
 	"orl %%ebx, %%eax\n\t"
@@ -84,8 +97,108 @@ void page_init() {
 	"orl %%ebx, %%eax\n\t"
 	"movl %%eax, %%cr0"
 	: /* no outputs */
-	: "r" (CR0_PG_FLAG), "r" (CR0_PE_FLAG) /* inputs */
+	: "r" (CR0_PG_FLAG | CR0_WP_FLAG), "r" (CR0_PE_FLAG) /* inputs */
 	: "%eax", "%ebx" /* clobber list */
 	);
 }
 
+
+/*
+* uint32_t alloc_frame()
+*	Inputs: none
+*	Return Value: physical address of a free 4KB frame, 0 if pool is exhausted
+*	Function: Allocates a frame from the heap pool
+*/
+uint32_t alloc_frame() {
+	uint32_t i, bit;
+	uint32_t flags;
+
+	spin_lock_irqsave(&frame_lock, flags);
+	for (i = 0; i < HEAP_POOL_FRAMES / 32; i++) {
+		/* Skip words with every frame taken */
+		if (frame_bitmap[i] == 0xFFFFFFFF)
+			continue;
+
+		for (bit = 0; bit < 32; bit++) {
+			if (!(frame_bitmap[i] & (1 << bit))) {
+				frame_bitmap[i] |= (1 << bit);
+				spin_unlock_irqrestore(&frame_lock, flags);
+				return HEAP_POOL_PHYS + (((i * 32) + bit) << PT_SHIFT);
+			}
+		}
+	}
+	spin_unlock_irqrestore(&frame_lock, flags);
+
+	return 0;
+}
+
+/*
+* void free_frame(uint32_t frame)
+*	Inputs: uint32_t frame = physical address returned by alloc_frame
+*	Return Value: none
+*	Function: Returns a frame to the heap pool
+*/
+void free_frame(uint32_t frame) {
+	uint32_t index = (frame - HEAP_POOL_PHYS) >> PT_SHIFT;
+	uint32_t flags;
+
+	if (frame < HEAP_POOL_PHYS || index >= HEAP_POOL_FRAMES)
+		return;
+
+	spin_lock_irqsave(&frame_lock, flags);
+	frame_bitmap[index / 32] &= ~(1 << (index % 32));
+	spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+* int32_t heap_fault(uint32_t fault_addr, uint32_t error_code)
+*	Inputs: uint32_t fault_addr = faulting linear address from CR2
+*			uint32_t error_code = error code pushed by the processor
+*	Return Value: 0 if the page was mapped and the access can be retried, -1 otherwise
+*	Function: Maps a zero-filled frame for a not-present page below the current break
+*/
+int32_t heap_fault(uint32_t fault_addr, uint32_t error_code) {
+	uint32_t frame;
+	uint32_t page = fault_addr & PAGE_MASK;
+
+	/* Only not-present faults inside the heap can be fixed up */
+	if (current_pcb == NULL || (error_code & PF_PRESENT_ERR))
+		return -1;
+
+	if (fault_addr < HEAP_VIRT_ADDR || page >= current_pcb->heap_brk)
+		return -1;
+
+	frame = alloc_frame();
+	if (frame == 0)
+		return -1;
+
+	/* Zero the frame through the kernel's view before the user sees it */
+	memset(phys_to_virt(frame), 0, PAGE_ALIGN);
+
+	heap_table[current_pcb->pid][(page >> PT_SHIFT) & PT_INDEX_MASK] = frame | US_FLAG | RW_FLAG | P_FLAG;
+	invlpg(page);
+
+	return 0;
+}
+
+/*
+* void heap_trim(uint32_t pid, uint32_t brk)
+*	Inputs: uint32_t pid = process whose heap shrinks
+*			uint32_t brk = new program break
+*	Return Value: none
+*	Function: Unmaps every heap page lying wholly above brk and frees its frame
+*/
+void heap_trim(uint32_t pid, uint32_t brk) {
+	int i;
+
+	/* First page index that no longer holds any heap byte */
+	i = ((brk - HEAP_VIRT_ADDR) + PAGE_ALIGN - 1) >> PT_SHIFT;
+
+	for (; i < PAGE_ENTRIES; i++) {
+		if (heap_table[pid][i] & P_FLAG) {
+			free_frame(heap_table[pid][i] & PAGE_MASK);
+			heap_table[pid][i] = 0;
+			invlpg(HEAP_VIRT_ADDR + (i << PT_SHIFT));
+		}
+	}
+}
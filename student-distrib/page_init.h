@@ -14,9 +14,11 @@
 #define PD_SHIFT 22				// Number of shifts to right to get 10 bit offset for page directory
 #define VID_MEM_ADDR 0x000B8000	// Starting address of video memory in physical address
 #define VID_MEM_VIRTUAL 0x08400000	// Virtual address 132MB
+#define APIC_PAGE_ADDR 0xFEC00000	// 4MB page holding the IOAPIC and local APIC registers
 
 #define CR0_PG_FLAG	 0x80000000	// Bit 31 enabling PG flag to enable paging
 #define CR0_PE_FLAG	 0x00000001	// Bit 1 switches processor to protected mode
+#define CR0_WP_FLAG	 0x00010000	// Bit 16 makes read-only pages read-only for the kernel too
 #define CR4_PSE_FLAG 0x00000010	// Bit 4 setting PSE flag to enable 4MB page access
 
 #define G_FLAG	 	 0x00000100	// Bit 8 set to indicate global page
@@ -28,12 +30,46 @@
 #define RW_FLAG		 0x00000002	// Bit 1 set to specify read-write privileges
 #define P_FLAG		 0x00000001	// Bit 0 of page directory/table entries to signal present
 
+#define PT_SHIFT 12				// Number of shifts to right to get page number
+#define PT_INDEX_MASK 0x3FF		// 10 bit index into a page table
+#define PAGE_MASK	 0xFFFFF000	// Clears offset within a 4KB page
+
+/* User heap */
+#define HEAP_VIRT_ADDR	 0x08800000	// Virtual address 136MB, start of each process heap
+#define HEAP_MAX_SIZE	 0x00400000	// Heap covered by one page table (4MB)
+#define HEAP_POOL_PHYS	 0x02000000	// Physical address 32MB (above process pages), pool of heap frames
+#define HEAP_POOL_FRAMES 1024		// Number of 4KB frames in heap pool
+
+/* Process slots and the heap pool stay mapped for the kernel at their
+ * physical addresses, so frames can be filled without a user mapping */
+#define PHYS_MAP_START	 PROCESS_BASE_ADDR
+#define PHYS_MAP_END	 (HEAP_POOL_PHYS + HEAP_POOL_FRAMES * PAGE_ALIGN)
+#define PHYS_MAP_PAGE	 0x00400000	// Mapped by 4MB pages
+#define phys_to_virt(frame) ((void*)(frame))
+#define PF_PRESENT_ERR	 0x00000001	// Page fault error code bit set on protection violation
+#define PF_WRITE_ERR	 0x00000002	// Page fault error code bit set when the access was a write
+
+/* Invalidate TLB entry for a single page */
+#define invlpg(addr)                    \
+do {                                    \
+	asm volatile("invlpg (%0)"          \
+			:                           \
+			: "r" (addr)                \
+			: "memory" );               \
+} while(0)
+
 void page_init();
 
+/* Heap frame allocation and demand paging */
+uint32_t alloc_frame();
+void free_frame(uint32_t frame);
+int32_t heap_fault(uint32_t fault_addr, uint32_t error_code);
+void heap_trim(uint32_t pid, uint32_t brk);
+
 extern int p_directory[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
 extern int p_table[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
-extern int process0_dir[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
-extern int process1_dir[PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
+extern int process_dir[][PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
+extern int prog_table[][PAGE_ENTRIES] __attribute__((aligned (PAGE_ALIGN)));
 
 #endif
 
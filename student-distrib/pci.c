@@ -0,0 +1,77 @@
+/* pci.c - PCI configuration space access and device lookup
+ * vim:ts=4 noexpandtab
+ */
+
+#include "pci.h"
+#include "lib.h"
+
+static spinlock_t pci_lock = SPIN_LOCK_UNLOCKED;
+
+/*
+ * pci_read
+ *   DESCRIPTION: Reads a configuration register with configuration
+ *                mechanism #1
+ *   INPUTS: uint32_t dev - PCI_DEV address of the function
+ *           uint32_t reg - dword-aligned register offset
+ *   OUTPUTS: none
+ *   RETURN VALUE: register value, all ones if there is no such function
+ */
+uint32_t
+pci_read(uint32_t dev, uint32_t reg)
+{
+	uint32_t flags, val;
+
+	spin_lock_irqsave(&pci_lock, flags);
+	outl(PCI_ENABLE | dev | (reg & ~0x3), PCI_CONFIG_ADDR);
+	val = inl(PCI_CONFIG_DATA);
+	spin_unlock_irqrestore(&pci_lock, flags);
+
+	return val;
+}
+
+/* Writes a configuration register, see pci_read */
+void
+pci_write(uint32_t dev, uint32_t reg, uint32_t val)
+{
+	uint32_t flags;
+
+	spin_lock_irqsave(&pci_lock, flags);
+	outl(PCI_ENABLE | dev | (reg & ~0x3), PCI_CONFIG_ADDR);
+	outl(val, PCI_CONFIG_DATA);
+	spin_unlock_irqrestore(&pci_lock, flags);
+}
+
+/*
+ * pci_find_class
+ *   DESCRIPTION: Scans every bus for a function of the given class
+ *   INPUTS: uint32_t class - base class code
+ *           uint32_t subclass - subclass code
+ *   OUTPUTS: uint32_t* dev - PCI_DEV address of the first match
+ *   RETURN VALUE: 0 if found, -1 otherwise
+ */
+int32_t
+pci_find_class(uint32_t class, uint32_t subclass, uint32_t* dev)
+{
+	uint32_t bus, slot, func, d, nfunc, cls;
+
+	for (bus = 0; bus < PCI_MAX_BUS; bus++) {
+		for (slot = 0; slot < PCI_MAX_SLOT; slot++) {
+			nfunc = 1;
+			for (func = 0; func < nfunc; func++) {
+				d = PCI_DEV(bus, slot, func);
+				if ((pci_read(d, PCI_ID) & 0xFFFF) == PCI_NO_DEVICE)
+					continue;
+				if (func == 0 && (pci_read(d, PCI_HEADER_TYPE) & PCI_MULTIFUNC))
+					nfunc = PCI_MAX_FUNC;
+
+				cls = pci_read(d, PCI_CLASS);
+				if ((cls >> 24) == class && ((cls >> 16) & 0xFF) == subclass) {
+					*dev = d;
+					return 0;
+				}
+			}
+		}
+	}
+
+	return -1;
+}
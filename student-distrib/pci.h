@@ -0,0 +1,42 @@
+/* pci.h - PCI configuration space access through I/O ports 0xCF8/0xCFC
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PCI_H
+#define _PCI_H
+
+#include "types.h"
+
+#define PCI_CONFIG_ADDR	0xCF8
+#define PCI_CONFIG_DATA	0xCFC
+#define PCI_ENABLE		0x80000000
+
+#define PCI_MAX_BUS		256
+#define PCI_MAX_SLOT	32
+#define PCI_MAX_FUNC	8
+
+/* Configuration header registers (byte offsets) */
+#define PCI_ID			0x00	// Device ID << 16 | vendor ID
+#define PCI_COMMAND		0x04
+#define PCI_CLASS		0x08	// Class << 24 | subclass << 16 | prog if << 8 | revision
+#define PCI_HEADER_TYPE	0x0C	// Header type in bits 16-23
+#define PCI_BAR0		0x10
+#define PCI_BAR4		0x20
+
+#define PCI_NO_DEVICE		0xFFFF
+#define PCI_MULTIFUNC		0x00800000
+#define PCI_CMD_IO			0x0001
+#define PCI_CMD_BUS_MASTER	0x0004
+#define PCI_BAR_IO			0x1
+#define PCI_BAR_IO_MASK		0xFFFFFFFC
+
+/* Device address, bus << 16 | slot << 11 | function << 8 */
+#define PCI_DEV(bus, slot, func) (((bus) << 16) | ((slot) << 11) | ((func) << 8))
+
+/* Read or write one 32-bit configuration register */
+uint32_t pci_read(uint32_t dev, uint32_t reg);
+void pci_write(uint32_t dev, uint32_t reg, uint32_t val);
+/* Find the first function with a class and subclass, -1 if there is none */
+int32_t pci_find_class(uint32_t class, uint32_t subclass, uint32_t* dev);
+
+#endif /* _PCI_H */
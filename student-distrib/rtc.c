@@ -1,6 +1,13 @@
 #include "rtc.h"
 #include "lib.h"
 #include "idt_entry_handler.h"
+#include "syscall.h"
+
+volatile uint32_t rtc_count;
+static wait_queue_t rtc_wq = WAIT_QUEUE_INIT;
+
+static void rtc_bottom_half(void* data);
+tasklet_t rtc_tasklet = TASKLET_INIT("rtc", rtc_bottom_half, NULL);
 
 /*
 * rtc_open
@@ -8,11 +15,13 @@
 *   INPUTS: const uint8_t* filename - unused
 *   OUTPUTS: none
 *   RETURN VALUE: 0
-*   SIDE EFFECTS: none
+*   SIDE EFFECTS: the descriptor's file_pos counts the ticks it has read
 */
 int32_t rtc_open (int32_t fd) {
 	unsigned long flags;
 
+	get_file(fd)->file_pos = rtc_count;
+
 	//Disable interrupts
 	cli_and_save(flags);
 
@@ -39,21 +48,43 @@ int32_t rtc_close (int32_t fd) {
 	return 0;
 }
 
+/*
+* rtc_poll
+*   DESCRIPTION: Readiness of an RTC descriptor. It can be read once an
+*	 interrupt has come since its last read; the rate can always be written.
+*   INPUTS: int32_t fd - RTC descriptor
+*           poll_table_t* pt - sleep to join, NULL to only test
+*   OUTPUTS: none
+*   RETURN VALUE: POLLOUT, and POLLIN if a tick is waiting
+*   SIDE EFFECTS: none
+*/
+uint32_t rtc_poll (int32_t fd, poll_table_t* pt) {
+	poll_wait(&rtc_wq, pt);
+
+	if (get_file(fd)->file_pos != rtc_count)
+		return POLLIN | POLLOUT;
+	return POLLOUT;
+}
+
 /*
 * rtc_read
-*   DESCRIPTION: Waits for RTC interrupt to occur.
-*   INPUTS: int32_t fd - unused
+*   DESCRIPTION: Sleeps until an RTC interrupt has come since the last
+*	 read of this descriptor.
+*   INPUTS: int32_t fd - RTC descriptor
 *           void* buf - unused
 *           int32_t nbytes - unused
 *   OUTPUTS: none
-*   RETURN VALUE: 0
-*   SIDE EFFECTS: waits until RTC interrupt occurs.
+*   RETURN VALUE: 0, -EAGAIN if no tick came yet on a non-blocking
+*	 descriptor, -1 if a signal ended the wait
+*   SIDE EFFECTS: marks every tick so far as read
 */
 int32_t rtc_read (int32_t fd, void* buf, int32_t nbytes) {
-	rtc_interrupted = 0;
-	//Wait for interrupt
-	while (rtc_interrupted == 0);
-		printf("");
+	int32_t ret;
+
+	if ((ret = wait_ready(fd, rtc_poll, POLLIN)) != 0)
+		return ret;
+
+	get_file(fd)->file_pos = rtc_count;
 	return 0;
 }
 
@@ -106,24 +137,33 @@ int32_t rtc_write (int32_t fd, const void* buf, int32_t nbytes) {
 /* 
 * rtc_handler
 *   DESCRIPTION: Called when rtc interrupt is generated
-*   INPUTS: n/a
-*   OUTPUTS: calls test_interrupts() function periodically
-*   RETURN VALUE: n/a
-*   SIDE EFFECTS: n/a
+*   INPUTS: uint32_t irq_num, void* ctx - unused
+*   OUTPUTS: queues rtc_tasklet
+*   RETURN VALUE: IRQ_HANDLED
+*   SIDE EFFECTS: reads register C so the RTC raises the next interrupt
 */
-void rtc_handler(void) {
-	uint32_t flags;
-	cli_and_save(flags);
-
-	//test_interrupts();
-
+int32_t rtc_handler(uint32_t irq_num, void* ctx) {
 	outb(REG_C, RTC_ADDR_PORT);
 	inb(RTC_DATA_PORT);
 
-	send_eoi(RTC_IRQ);
+	tasklet_schedule(&rtc_tasklet);
 
-	restore_flags(flags);
-	sti();
+	return IRQ_HANDLED;
+}
+
+/* 
+* rtc_bottom_half
+*   DESCRIPTION: Work of an RTC tick, run after the interrupt with
+*	 interrupts enabled
+*   INPUTS: void* data - unused
+*   OUTPUTS: wakes rtc_read and poll
+*   RETURN VALUE: n/a
+*   SIDE EFFECTS: n/a
+*/
+static void rtc_bottom_half(void* data) {
+	//test_interrupts();
+	rtc_count++;
+	wake_up(&rtc_wq);
 }
 
 
@@ -140,6 +180,7 @@ void initialize_rtc(void) {
 	unsigned long flags;
 	cli_and_save(flags); //Disable interrupts
 
+	request_irq(RTC_IRQ, rtc_handler, NULL);
 	enable_irq(PIC_CASCADE_IRQ);
 	enable_irq(RTC_IRQ);
 
@@ -7,8 +7,10 @@
 
 #include "types.h"
 #include "lib.h"
-#include "i8259.h"
+#include "irq.h"
+#include "softirq.h"
 #include "idt_entry_handler.h"
+#include "sched.h"
 
 #define RTC_IRQ 8
 #define PIC_CASCADE_IRQ 2
@@ -21,16 +23,18 @@
 #define WRITE_MASK 0xF0
 #define RTC_DEFAULT 2
 
-void rtc_handler(void);
+int32_t rtc_handler(uint32_t irq_num, void* ctx);
 void initialize_rtc(void);
 
 int32_t rtc_read (int32_t fd, void* buf, int32_t nbytes);
 int32_t rtc_write (int32_t fd, const void* buf, int32_t nbytes);
 int32_t rtc_open (int32_t fd);
 int32_t rtc_close (int32_t fd);
+uint32_t rtc_poll (int32_t fd, poll_table_t* pt);
 
 unsigned char rate_to_arg(uint32_t rtc_rate);
 
-extern volatile int rtc_interrupted;
+extern volatile uint32_t rtc_count;
+extern tasklet_t rtc_tasklet;
 
 #endif
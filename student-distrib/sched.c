@@ -0,0 +1,566 @@
+/* sched.c - Per-CPU run queues, work stealing and process switching
+ * vim:ts=4 noexpandtab
+ */
+
+#include "sched.h"
+#include "smp.h"
+#include "syscall.h"
+
+wait_queue_t tick_wq = WAIT_QUEUE_INIT;
+
+/* Append a process to the tail of a run queue, caller holds the lock */
+static int32_t
+rq_push(run_queue_t* rq, pcb_t* proc)
+{
+	if (rq->nr_running == RUNQ_SIZE)
+		return -1;
+
+	rq->proc[rq->tail] = proc;
+	rq->tail = (rq->tail + 1) % RUNQ_SIZE;
+	rq->nr_running++;
+	return 0;
+}
+
+/* Remove the process at the head of a run queue, caller holds the lock */
+static pcb_t*
+rq_pop(run_queue_t* rq)
+{
+	pcb_t* proc;
+
+	if (rq->nr_running == 0)
+		return NULL;
+
+	proc = rq->proc[rq->head];
+	rq->head = (rq->head + 1) % RUNQ_SIZE;
+	rq->nr_running--;
+	return proc;
+}
+
+/* Remove the i-th queued process (0 is the head), caller holds the lock */
+static pcb_t*
+rq_remove(run_queue_t* rq, uint32_t i)
+{
+	pcb_t* proc = rq->proc[(rq->head + i) % RUNQ_SIZE];
+
+	/* Close the gap by moving the older entries up one slot */
+	for (; i > 0; i--)
+		rq->proc[(rq->head + i) % RUNQ_SIZE] = rq->proc[(rq->head + i - 1) % RUNQ_SIZE];
+
+	rq->head = (rq->head + 1) % RUNQ_SIZE;
+	rq->nr_running--;
+	return proc;
+}
+
+/*
+ * steal
+ *   DESCRIPTION: Takes a runnable process from the busiest other CPU. The
+ *                oldest process that has not run there within
+ *                CACHE_HOT_TICKS is preferred; a queue of only cache-hot
+ *                processes is left alone unless it holds more than one.
+ *   INPUTS: cpu_t* cpu - the idle CPU
+ *   OUTPUTS: none
+ *   RETURN VALUE: stolen process, now owned by cpu, or NULL
+ */
+static pcb_t*
+steal(cpu_t* cpu)
+{
+	cpu_t* victim = NULL;
+	pcb_t* proc = NULL;
+	uint32_t i;
+
+	/* Pick the longest queue without locking, recheck under its lock */
+	for (i = 0; i < num_cpus; i++) {
+		if (&cpus[i] == cpu || !cpus[i].online || cpus[i].rq.nr_running == 0)
+			continue;
+		if (victim == NULL || cpus[i].rq.nr_running > victim->rq.nr_running)
+			victim = &cpus[i];
+	}
+	if (victim == NULL)
+		return NULL;
+
+	spin_lock(&victim->rq.lock);
+	for (i = 0; i < victim->rq.nr_running; i++) {
+		pcb_t* p = victim->rq.proc[(victim->rq.head + i) % RUNQ_SIZE];
+		if (victim->ticks - p->last_ran >= CACHE_HOT_TICKS)
+			break;
+	}
+	if (i == victim->rq.nr_running && victim->rq.nr_running > 1)
+		i = 0;
+	if (i < victim->rq.nr_running) {
+		proc = rq_remove(&victim->rq, i);
+		victim->rq.stolen++;
+	}
+	spin_unlock(&victim->rq.lock);
+
+	if (proc != NULL) {
+		proc->cpu = cpu->id;
+		proc->migrations++;
+		cpu->rq.steals++;
+	}
+
+	return proc;
+}
+
+/*
+ * sched_enqueue
+ *   DESCRIPTION: Queues a runnable process on a CPU
+ *   INPUTS: uint32_t cpu - logical CPU number
+ *           pcb_t* proc - process to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if the queue is full
+ */
+int32_t
+sched_enqueue(uint32_t cpu, pcb_t* proc)
+{
+	uint32_t flags;
+	int32_t ret;
+
+	spin_lock_irqsave(&cpus[cpu].rq.lock, flags);
+	proc->cpu = cpu;
+	proc->state = TASK_RUNNING;
+	ret = rq_push(&cpus[cpu].rq, proc);
+	spin_unlock_irqrestore(&cpus[cpu].rq.lock, flags);
+
+	return ret;
+}
+
+/*
+ * sched_pick_cpu
+ *   DESCRIPTION: Chooses where to queue a new process
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: online CPU with the fewest runnable processes, counting
+ *                 the one it is running
+ */
+uint32_t
+sched_pick_cpu(void)
+{
+	uint32_t i, load;
+	uint32_t best = 0;
+	uint32_t best_load = (uint32_t)-1;
+
+	for (i = 0; i < num_cpus; i++) {
+		if (!cpus[i].online)
+			continue;
+		load = cpus[i].rq.nr_running +
+			(cpus[i].current != NULL && cpus[i].current->state == TASK_RUNNING);
+		if (load < best_load) {
+			best = i;
+			best_load = load;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * schedule
+ *   DESCRIPTION: Rotates the calling CPU's run queue. The running process
+ *                goes to the tail if it is still runnable. When the queue
+ *                is empty and the running process blocked, or the CPU is
+ *                idle, a process is stolen from another CPU; a blocked
+ *                process waits here until something is queued or it is
+ *                woken.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: may switch page directory, TSS stack and kernel stack
+ */
+void
+schedule(void)
+{
+	uint32_t flags;
+	cpu_t* cpu;
+	pcb_t* prev;
+	pcb_t* next;
+	uint32_t* prev_ksp;
+
+	cli_and_save(flags);
+	cpu = this_cpu();
+	prev = cpu->current;
+
+	while (1) {
+		spin_lock(&cpu->rq.lock);
+		next = rq_pop(&cpu->rq);
+		spin_unlock(&cpu->rq.lock);
+
+		/* Only a CPU with nothing to run steals; a runnable current
+		 * process just keeps the CPU */
+		if (next == NULL && (prev == NULL || prev->state != TASK_RUNNING))
+			next = steal(cpu);
+
+		if (next != NULL) {
+			spin_lock(&cpu->rq.lock);
+			if (prev != NULL && prev->state == TASK_RUNNING)
+				rq_push(&cpu->rq, prev);
+			cpu->current = next;
+			cpu->rq.switches++;
+			spin_unlock(&cpu->rq.lock);
+			break;
+		}
+
+		if (prev == NULL || prev->state == TASK_RUNNING)
+			break;
+
+		/* Current process blocked and nothing else to run */
+		asm volatile("sti; hlt; cli" : : : "memory");
+	}
+
+	if (next == NULL) {
+		restore_flags(flags);
+		return;
+	}
+
+	/* A stolen process may still be leaving its old CPU's stack */
+	while (next->on_cpu)
+		asm volatile("pause" : : : "memory");
+	next->on_cpu = 1;
+
+	next->stack_cpu = cpu;
+	prev_ksp = (prev == NULL) ? &cpu->idle_ksp : &prev->ksp;
+	cpu->prev = prev;
+	fpu_switch_out(prev);
+
+	cpu->tss->esp0 = PROCESS_KERNEL_STACK(next->pid);
+	asm volatile("movl %0, %%cr3"
+	: /* no outputs */
+	: "r" (next->p_dir) /* inputs */
+	: "memory"
+	);
+
+	switch_to(prev_ksp, next->ksp);
+
+	/* Possibly resumed on a different CPU */
+	finish_switch();
+	restore_flags(flags);
+}
+
+/*
+ * finish_switch
+ *   DESCRIPTION: Releases the process just switched away from, once
+ *                nothing on this CPU uses its kernel stack any more
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+finish_switch(void)
+{
+	cpu_t* cpu = this_cpu();
+	pcb_t* prev = cpu->prev;
+
+	if (prev == NULL)
+		return;
+
+	cpu->prev = NULL;
+	prev->last_ran = cpu->ticks;
+	asm volatile("" : : : "memory");
+	prev->on_cpu = 0;
+}
+
+/*
+ * set_current_state
+ *   DESCRIPTION: Sets the state of the running process. Called with
+ *                TASK_BLOCKED before testing a wakeup condition, so a
+ *                sched_wake racing with the test is not lost.
+ *   INPUTS: uint32_t state - TASK_RUNNING, TASK_BLOCKED or TASK_ZOMBIE
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+set_current_state(uint32_t state)
+{
+	uint32_t flags;
+	cpu_t* cpu;
+
+	cli_and_save(flags);
+	cpu = this_cpu();
+	spin_lock(&cpu->rq.lock);
+	cpu->current->state = state;
+	spin_unlock(&cpu->rq.lock);
+	restore_flags(flags);
+}
+
+/*
+ * sched_block
+ *   DESCRIPTION: Marks the running process blocked and gives up the CPU
+ *                until sched_wake is called on it
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+sched_block(void)
+{
+	set_current_state(TASK_BLOCKED);
+	schedule();
+}
+
+/*
+ * sched_wake
+ *   DESCRIPTION: Makes a blocked process runnable on the CPU it last ran on
+ *   INPUTS: pcb_t* proc - process to wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+sched_wake(pcb_t* proc)
+{
+	uint32_t flags;
+	cpu_t* cpu = &cpus[proc->cpu];
+
+	spin_lock_irqsave(&cpu->rq.lock, flags);
+	if (proc->state == TASK_BLOCKED) {
+		proc->state = TASK_RUNNING;
+		/* Still waiting inside schedule() on its CPU, no need to queue */
+		if (cpu->current != proc)
+			rq_push(&cpu->rq, proc);
+	}
+	spin_unlock_irqrestore(&cpu->rq.lock, flags);
+}
+
+/* Add a process to a free slot of a wait queue, -1 if it is full */
+static int32_t
+wq_add(wait_queue_t* wq, pcb_t* proc)
+{
+	uint32_t flags, i;
+
+	spin_lock_irqsave(&wq->lock, flags);
+	for (i = 0; i < WAITQ_SIZE && wq->proc[i] != NULL; i++);
+	if (i < WAITQ_SIZE)
+		wq->proc[i] = proc;
+	spin_unlock_irqrestore(&wq->lock, flags);
+
+	return (i < WAITQ_SIZE) ? (int32_t)i : -1;
+}
+
+/* Empty a slot filled by wq_add */
+static void
+wq_del(wait_queue_t* wq, uint32_t slot)
+{
+	uint32_t flags;
+
+	spin_lock_irqsave(&wq->lock, flags);
+	wq->proc[slot] = NULL;
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/*
+ * wait_event
+ *   DESCRIPTION: Sleeps until *cond becomes nonzero. The waker sets the
+ *                condition before calling wake_up. Before the first
+ *                process runs there is nothing to switch to, so the CPU
+ *                halts until the interrupt that sets the condition.
+ *   INPUTS: wait_queue_t* wq - queue the condition's waker wakes
+ *           volatile uint32_t* cond - wakeup condition
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+wait_event(wait_queue_t* wq, volatile uint32_t* cond)
+{
+	pcb_t* proc;
+	uint32_t flags;
+	int32_t slot;
+
+	cli_and_save(flags);
+	proc = this_cpu()->current;
+	if (proc == NULL) {
+		while (!*cond)
+			asm volatile("sti; hlt; cli" : : : "memory");
+		restore_flags(flags);
+		return;
+	}
+	restore_flags(flags);
+
+	slot = wq_add(wq, proc);
+
+	while (1) {
+		set_current_state(TASK_BLOCKED);
+		if (*cond)
+			break;
+		/* A full queue cannot wake us, poll on the next tick instead */
+		if (slot < 0)
+			set_current_state(TASK_RUNNING);
+		schedule();
+	}
+	set_current_state(TASK_RUNNING);
+
+	if (slot >= 0)
+		wq_del(wq, slot);
+}
+
+/*
+ * wake_up
+ *   DESCRIPTION: Makes every process sleeping on a wait queue runnable, each
+ *                retests its condition. Safe from interrupt handlers.
+ *   INPUTS: wait_queue_t* wq - queue to wake
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+wake_up(wait_queue_t* wq)
+{
+	uint32_t flags, i;
+
+	spin_lock_irqsave(&wq->lock, flags);
+	for (i = 0; i < WAITQ_SIZE; i++) {
+		if (wq->proc[i] != NULL)
+			sched_wake(wq->proc[i]);
+	}
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/* Start an empty poll table */
+void
+poll_init(poll_table_t* pt)
+{
+	pt->n = 0;
+	pt->full = 0;
+}
+
+/*
+ * poll_wait
+ *   DESCRIPTION: Puts the running process on a wait queue until poll_free,
+ *                so waking it ends poll_schedule. Called by backend poll
+ *                callbacks for each queue their readiness depends on.
+ *   INPUTS: wait_queue_t* wq - queue to sleep on
+ *           poll_table_t* pt - table of the sleep, NULL to only test
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+poll_wait(wait_queue_t* wq, poll_table_t* pt)
+{
+	int32_t slot;
+	uint32_t i;
+
+	if (pt == NULL)
+		return;
+
+	for (i = 0; i < pt->n; i++) {
+		if (pt->wq[i] == wq)
+			return;
+	}
+
+	if (pt->n == POLL_MAX_WAITS || (slot = wq_add(wq, current_pcb)) < 0) {
+		pt->full = 1;
+		return;
+	}
+	pt->wq[pt->n] = wq;
+	pt->slot[pt->n] = slot;
+	pt->n++;
+}
+
+/*
+ * poll_schedule
+ *   DESCRIPTION: Switches away from a process that set itself blocked and
+ *                found nothing ready, until a queue in pt is woken. If a
+ *                queue was full it only yields, to test again soon.
+ *   INPUTS: poll_table_t* pt - queues the process is on
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+poll_schedule(poll_table_t* pt)
+{
+	if (pt->full)
+		set_current_state(TASK_RUNNING);
+	schedule();
+}
+
+/* Leave every queue in a poll table */
+void
+poll_free(poll_table_t* pt)
+{
+	uint32_t i;
+
+	for (i = 0; i < pt->n; i++)
+		wq_del(pt->wq[i], pt->slot[i]);
+	pt->n = 0;
+}
+
+/*
+ * wait_ready
+ *   DESCRIPTION: Sleeps until the poll callback of a backend reports one of
+ *                events on fd. Blocking reads use it so that they end on
+ *                exactly the condition poll reports. A descriptor set
+ *                O_NONBLOCK does not sleep.
+ *   INPUTS: int32_t fd - descriptor of the calling process
+ *           poll_fn_t poll - poll callback of its backend
+ *           uint32_t events - POLL* bits to wait for
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 once ready, -EAGAIN if it is not and fd is
+ *                 non-blocking, -1 if a signal is pending first
+ */
+int32_t
+wait_ready(int32_t fd, poll_fn_t poll, uint32_t events)
+{
+	poll_table_t pt;
+	pcb_t* proc = current_pcb;
+	file_desc_t* file = get_file(fd);
+	int32_t ret = -1;
+
+	if (file != NULL && (file->flags & O_NONBLOCK))
+		return (poll(fd, NULL) & events) ? 0 : -EAGAIN;
+
+	poll_init(&pt);
+	while (1) {
+		set_current_state(TASK_BLOCKED);
+		if (poll(fd, &pt) & events) {
+			ret = 0;
+			break;
+		}
+		if (signal_pending(proc))
+			break;
+		poll_schedule(&pt);
+	}
+	set_current_state(TASK_RUNNING);
+	poll_free(&pt);
+
+	return ret;
+}
+
+/*
+ * cpu_idle
+ *   DESCRIPTION: Idle loop of a CPU, runs queued processes when there are
+ *                any and halts until the next interrupt otherwise
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: never returns
+ */
+void
+cpu_idle(void)
+{
+	while (1) {
+		schedule();
+		asm volatile("sti; hlt" : : : "memory");
+	}
+}
+
+/*
+ * syscall_schedstat
+ *   DESCRIPTION: Copies the scheduler counters of each CPU to user space
+ *   INPUTS: sched_stat_t* buf - array to fill
+ *           int32_t n - number of entries in buf
+ *   OUTPUTS: one entry per CPU, up to n
+ *   RETURN VALUE: number of CPUs online, -1 on a bad buffer
+ */
+int32_t
+syscall_schedstat(sched_stat_t* buf, int32_t n)
+{
+	uint32_t i;
+
+	if (buf == NULL || n < 0)
+		return -1;
+
+	for (i = 0; i < num_cpus && i < n; i++) {
+		buf[i].ticks = cpus[i].ticks;
+		buf[i].nr_running = cpus[i].rq.nr_running + (cpus[i].current != NULL);
+		buf[i].steals = cpus[i].rq.steals;
+		buf[i].stolen = cpus[i].rq.stolen;
+		buf[i].switches = cpus[i].rq.switches;
+	}
+
+	return smp_online();
+}
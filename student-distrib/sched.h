@@ -0,0 +1,125 @@
+/* sched.h - Defines for per-CPU run queues and process switching
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include "types.h"
+#include "lib.h"
+
+#define RUNQ_SIZE 16		// Maximum runnable processes queued on one CPU
+#define CACHE_HOT_TICKS 2	// Ticks after running during which a process is left on its CPU
+#define WAITQ_SIZE 8		// Processes sleeping on one wait queue at once
+#define POLL_MAX_WAITS 16	// Wait queues one poll table can sleep on
+
+/* Readiness bits returned by the poll callback of a file backend */
+#define POLLIN		0x0001
+#define POLLOUT		0x0004
+#define POLLERR		0x0008
+#define POLLHUP		0x0010
+#define POLLNVAL	0x0020
+
+/* Process states */
+#define TASK_RUNNING 0
+#define TASK_BLOCKED 1
+#define TASK_ZOMBIE 2
+
+struct pcb_t;
+
+/* Ring of runnable processes owned by one CPU. The owner runs them from
+ * the head; an idle CPU may steal the oldest one that is no longer cache
+ * hot. Every access takes the lock rather than splitting into a lock-free
+ * owner end and a thief end: wakeups and sched_enqueue push from any CPU,
+ * a steal removes from the middle to skip cache-hot processes, and with
+ * at most MAX_PROCESSES entries and steals only from idle CPUs the lock is
+ * rarely contended. */
+typedef struct run_queue_t {
+	spinlock_t lock;
+	uint32_t head;
+	uint32_t tail;
+	uint32_t nr_running;
+	struct pcb_t* proc[RUNQ_SIZE];
+
+	/* Statistics */
+	uint32_t steals;		// Processes this CPU took from others
+	uint32_t stolen;		// Processes others took from this CPU
+	uint32_t switches;
+} run_queue_t;
+
+/* Processes sleeping until an event, woken together by wake_up */
+typedef struct wait_queue_t {
+	spinlock_t lock;
+	struct pcb_t* proc[WAITQ_SIZE];
+} wait_queue_t;
+
+#define WAIT_QUEUE_INIT { SPIN_LOCK_UNLOCKED }
+
+/* Wait queues a process sleeps on while it polls several sources. Backend
+ * poll callbacks add their queue with poll_wait; poll_free leaves them all. */
+typedef struct poll_table_t {
+	uint32_t n;
+	uint32_t full;		// A queue had no free slot, wake on every tick instead
+	wait_queue_t* wq[POLL_MAX_WAITS];
+	uint32_t slot[POLL_MAX_WAITS];
+} poll_table_t;
+
+/* Readiness of fd, registering on its wait queues when pt is not NULL */
+typedef uint32_t (*poll_fn_t)(int32_t fd, poll_table_t* pt);
+
+/* Woken on every timer tick of CPU 0, for sleeps with a timeout */
+extern wait_queue_t tick_wq;
+
+/* Scheduler statistics of one CPU, copied out by SYS_SCHEDSTAT */
+typedef struct sched_stat_t {
+	uint32_t ticks;
+	uint32_t nr_running;
+	uint32_t steals;
+	uint32_t stolen;
+	uint32_t switches;
+} sched_stat_t;
+
+/* Queue a runnable process on a CPU */
+int32_t sched_enqueue(uint32_t cpu, struct pcb_t* proc);
+/* Online CPU with the fewest runnable processes */
+uint32_t sched_pick_cpu(void);
+/* Pick the next process from the calling CPU's queue and switch to it */
+void schedule(void);
+/* Mark the running process blocked and switch away */
+void sched_block(void);
+/* Set the running process's state before testing a wakeup condition */
+void set_current_state(uint32_t state);
+/* Make a blocked process runnable on the CPU it last ran on */
+void sched_wake(struct pcb_t* proc);
+/* Sleep on a wait queue until *cond is nonzero */
+void wait_event(wait_queue_t* wq, volatile uint32_t* cond);
+/* Wake every process sleeping on a wait queue */
+void wake_up(wait_queue_t* wq);
+/* Start an empty poll table */
+void poll_init(poll_table_t* pt);
+/* Sleep on wq as well while pt is in use, called by poll callbacks */
+void poll_wait(wait_queue_t* wq, poll_table_t* pt);
+/* Give up the CPU until one of the queues in pt is woken */
+void poll_schedule(poll_table_t* pt);
+/* Leave every queue in pt */
+void poll_free(poll_table_t* pt);
+/* Sleep until poll reports one of events on fd, or a signal is pending;
+ * a non-blocking fd fails with -EAGAIN instead */
+int32_t wait_ready(int32_t fd, poll_fn_t poll, uint32_t events);
+/* Called on the new stack right after switch_to */
+void finish_switch(void);
+/* Idle loop of a CPU with nothing to run */
+void cpu_idle(void);
+/* Copy per-CPU statistics to a user buffer */
+int32_t syscall_schedstat(sched_stat_t* buf, int32_t n);
+
+/* Save callee-saved state on this stack into *prev_ksp and resume next_ksp */
+void switch_to(uint32_t* prev_ksp, uint32_t next_ksp);
+/* First code run by a process created by a background execute */
+void new_process_entry(void);
+/* Save this kernel stack and iret into user mode, returns the exit status */
+int32_t enter_user(uint32_t* saved_ksp, uint32_t entry, uint32_t user_esp, uint32_t eflags);
+/* Resume the stack saved by enter_user, clearing *on_cpu once off this one */
+void return_to_parent(uint32_t saved_ksp, int32_t status, volatile uint32_t* on_cpu);
+
+#endif /* _SCHED_H */
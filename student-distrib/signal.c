@@ -0,0 +1,194 @@
+/* signal.c - User signal delivery and the set_handler/sigreturn calls
+ * vim:ts=4 noexpandtab
+ */
+
+#include "signal.h"
+#include "syscall.h"
+#include "idt_entry_handler.h"
+#include "lib.h"
+
+#define SYS_SIGRETURN_NUM 10
+
+/* movl $SYS_SIGRETURN, %eax; int $0x80 */
+static const uint8_t sigreturn_trampoline[SIGRETURN_TRAMPOLINE_SIZE] = {
+	0xB8, SYS_SIGRETURN_NUM, 0x00, 0x00, 0x00, 0xCD, 0x80, 0x90
+};
+
+/* Pending masks are updated from other CPUs (keyboard, timer) */
+static spinlock_t sig_lock = SPIN_LOCK_UNLOCKED;
+
+/*
+ * send_signal
+ *   DESCRIPTION: Marks a signal pending on a process and wakes it if it
+ *                sleeps. It is delivered the next time the process returns
+ *                to user space.
+ *   INPUTS: pcb_t* proc - target process
+ *           uint32_t signum - SIG_DIV_ZERO ... SIG_USER1
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+send_signal(pcb_t* proc, uint32_t signum)
+{
+	uint32_t flags;
+
+	if (proc == NULL || signum >= NUM_SIGNALS)
+		return;
+
+	spin_lock_irqsave(&sig_lock, flags);
+	proc->sig_pending |= (1 << signum);
+	spin_unlock_irqrestore(&sig_lock, flags);
+
+	/* Sleeps that can be cut short see the signal, others sleep again */
+	sched_wake(proc);
+}
+
+/* Action taken for a signal with no handler installed */
+void
+sig_default(uint32_t signum)
+{
+	switch (signum) {
+		case SIG_DIV_ZERO:
+		case SIG_SEGFAULT:
+		case SIG_INTERRUPT:
+			process_halt(KILLED_STATUS);
+			break;
+		default:
+			/* ALARM and USER1 are ignored */
+			break;
+	}
+}
+
+/*
+ * send_fault_signal
+ *   DESCRIPTION: Signals a fault the current process raised in user mode.
+ *                Unlike send_signal it cannot wait: returning to the
+ *                faulting instruction would just fault again. A fault
+ *                whose signal is blocked, as every signal is while a
+ *                handler runs, kills the process with KILLED_STATUS.
+ *   INPUTS: uint32_t signum - SIG_DIV_ZERO or SIG_SEGFAULT
+ *   OUTPUTS: none
+ *   RETURN VALUE: none, does not return if the process is killed
+ */
+void
+send_fault_signal(uint32_t signum)
+{
+	pcb_t* proc = current_pcb;
+
+	if (proc->sig_blocked & (1 << signum)) {
+		sig_default(signum);
+		return;
+	}
+
+	send_signal(proc, signum);
+}
+
+/*
+ * do_signal
+ *   DESCRIPTION: Called on every return to user space. Takes the lowest
+ *                pending, unblocked signal and either runs its default
+ *                action or redirects the return into the user handler,
+ *                with a sig_frame_t holding the interrupted context pushed
+ *                on the user stack. Further signals are blocked until the
+ *                handler calls sigreturn.
+ *   INPUTS: intr_frame_t* frame - registers the kernel is about to restore
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+do_signal(intr_frame_t* frame)
+{
+	pcb_t* proc = current_pcb;
+	sig_frame_t sf;
+	uint32_t pending, signum, sp, flags;
+
+	if (proc == NULL || !(frame->cs & USER_RPL_MASK))
+		return;
+
+	pending = proc->sig_pending & ~proc->sig_blocked;
+	if (pending == 0)
+		return;
+
+	for (signum = 0; !(pending & (1 << signum)); signum++);
+
+	spin_lock_irqsave(&sig_lock, flags);
+	proc->sig_pending &= ~(1 << signum);
+	spin_unlock_irqrestore(&sig_lock, flags);
+
+	if (proc->sig_handler[signum] == 0) {
+		sig_default(signum);
+		return;
+	}
+
+	/* The frame must fit on the user stack, below the interrupted ESP */
+	sp = (frame->user_esp - sizeof(sig_frame_t)) & ~3;
+	if (frame->user_esp > USER_STACK || sp < PROG_VIRT_ADDR || sp > frame->user_esp) {
+		sig_default(SIG_SEGFAULT);
+		return;
+	}
+
+	/* Build the frame in one piece, then a single copy out */
+	sf.ret_addr = (uint32_t)((sig_frame_t*)sp)->trampoline;
+	sf.signum = signum;
+	sf.context = *frame;
+	memcpy(sf.trampoline, sigreturn_trampoline, SIGRETURN_TRAMPOLINE_SIZE);
+	memcpy((void*)sp, &sf, sizeof(sig_frame_t));
+
+	proc->sig_blocked = SIG_ALL_MASK;
+	frame->user_esp = sp;
+	frame->eip = proc->sig_handler[signum];
+}
+
+/*
+ * syscall_set_handler
+ *   DESCRIPTION: Installs a user handler for a signal
+ *   INPUTS: int32_t signum - signal number
+ *           void* handler_address - handler, NULL for the default action
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on a bad signal number
+ */
+int32_t
+syscall_set_handler(int32_t signum, void* handler_address)
+{
+	if (signum < 0 || signum >= NUM_SIGNALS)
+		return -1;
+
+	current_pcb->sig_handler[signum] = (uint32_t)handler_address;
+
+	return 0;
+}
+
+/*
+ * syscall_sigreturn
+ *   DESCRIPTION: Called by the trampoline when a handler returns. Copies
+ *                the context saved by do_signal (possibly changed by the
+ *                handler) over this system call's frame. Segment
+ *                registers and privileged flags are not taken from user
+ *                memory.
+ *   INPUTS: intr_frame_t* frame - frame of the sigreturn system call
+ *   OUTPUTS: none
+ *   RETURN VALUE: restored EAX, stored back into the frame by the caller
+ */
+int32_t
+syscall_sigreturn(intr_frame_t* frame)
+{
+	intr_frame_t* ctx = (intr_frame_t*)(frame->user_esp + sizeof(uint32_t));
+
+	/* Context sits above signum, which is at the user ESP */
+	if ((uint32_t)ctx < PROG_VIRT_ADDR || (uint32_t)ctx > USER_STACK - sizeof(intr_frame_t))
+		return -1;
+
+	frame->ebx = ctx->ebx;
+	frame->ecx = ctx->ecx;
+	frame->edx = ctx->edx;
+	frame->esi = ctx->esi;
+	frame->edi = ctx->edi;
+	frame->ebp = ctx->ebp;
+	frame->eip = ctx->eip;
+	frame->user_esp = ctx->user_esp;
+	frame->eflags = (frame->eflags & ~USER_EFLAGS_MASK) | (ctx->eflags & USER_EFLAGS_MASK);
+
+	current_pcb->sig_blocked = 0;
+
+	return ctx->eax;
+}
@@ -0,0 +1,53 @@
+/* signal.h - Defines for user signal delivery
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SIGNAL_H
+#define _SIGNAL_H
+
+#include "types.h"
+#include "intr_entry.h"
+
+/* Signal numbers, as in ece391syscall.h */
+#define SIG_DIV_ZERO	0
+#define SIG_SEGFAULT	1
+#define SIG_INTERRUPT	2
+#define SIG_ALARM		3
+#define SIG_USER1		4
+#define NUM_SIGNALS		5
+#define SIG_ALL_MASK	((1 << NUM_SIGNALS) - 1)
+
+#define DIVIDE_ERROR_VECTOR 0
+#define ALARM_TICKS 600			// Local APIC timer ticks between ALARMs, ~10s under QEMU
+#define USER_EFLAGS_MASK 0x00000CD5	// Flags sigreturn may restore (CF PF AF ZF SF DF OF)
+#define SIGRETURN_TRAMPOLINE_SIZE 8
+
+/* Pushed on the user stack when a handler is called. The handler sees
+ * signum as its argument and returns into the trampoline, which calls
+ * sigreturn with the context just above signum. */
+typedef struct sig_frame_t {
+	uint32_t ret_addr;
+	uint32_t signum;
+	intr_frame_t context;
+	uint8_t trampoline[SIGRETURN_TRAMPOLINE_SIZE];
+} sig_frame_t;
+
+struct pcb_t;
+
+/* Nonzero when a signal will be delivered on the next return to user space */
+#define signal_pending(proc) ((proc)->sig_pending & ~(proc)->sig_blocked)
+
+/* Mark a signal pending on a process */
+void send_signal(struct pcb_t* proc, uint32_t signum);
+/* Signal a user-mode fault of the current process, killing it if blocked */
+void send_fault_signal(uint32_t signum);
+/* Run the default action of a signal on the current process */
+void sig_default(uint32_t signum);
+/* Deliver a pending signal before returning to user space */
+void do_signal(intr_frame_t* frame);
+
+/* System calls */
+int32_t syscall_set_handler(int32_t signum, void* handler_address);
+int32_t syscall_sigreturn(intr_frame_t* frame);
+
+#endif /* _SIGNAL_H */
@@ -0,0 +1,280 @@
+/* smp.c - Functions to find and start the application processors
+ * vim:ts=4 noexpandtab
+ */
+
+#include "smp.h"
+#include "apic.h"
+#include "ioapic.h"
+#include "lib.h"
+#include "syscall.h"
+#include "fpu.h"
+
+#define IO_DELAY_PORT 0x80
+#define INIT_DELAY 10000	// ~10ms in port delays
+#define SIPI_DELAY 200		// ~200us in port delays
+#define AP_WAIT_LOOPS 100000
+
+cpu_t cpus[MAX_CPUS];
+uint32_t num_cpus = 1;
+uint32_t mp_imcr_present = 0;
+
+/* Map from APIC ID to logical CPU number */
+
+/* Task state segments and boot/idle stacks of the other processors */
+static tss_t cpu_tss[MAX_CPUS];
+static uint8_t cpu_stack[MAX_CPUS][STACK_SIZE] __attribute__((aligned (STACK_SIZE)));
+
+/* Roughly one microsecond per port write */
+static void
+io_delay(uint32_t n)
+{
+	while (n--)
+		outb(0, IO_DELAY_PORT);
+}
+
+/* Sum of bytes, zero for a valid MP structure */
+static uint8_t
+mp_checksum(uint8_t* addr, uint32_t len)
+{
+	uint8_t sum = 0;
+	while (len--)
+		sum += *addr++;
+	return sum;
+}
+
+/* Search a physical range for the MP floating pointer */
+static mp_float_t*
+mp_search(uint32_t start, uint32_t end)
+{
+	uint32_t addr;
+	mp_float_t* mpf;
+
+	for (addr = start; addr < end; addr += sizeof(mp_float_t)) {
+		mpf = (mp_float_t*)addr;
+		if (mpf->signature == MP_FLOAT_SIG &&
+				mp_checksum((uint8_t*)mpf, sizeof(mp_float_t)) == 0)
+			return mpf;
+	}
+
+	return NULL;
+}
+
+/* Build the GDT entry for a CPU's TSS and load it */
+static void
+cpu_load_tss(cpu_t* cpu)
+{
+	seg_desc_t the_tss_desc;
+
+	if (cpu->id == 0) {
+		/* The boot processor uses the TSS set up in entry() */
+		return;
+	}
+
+	the_tss_desc.granularity    = 0;
+	the_tss_desc.opsize         = 0;
+	the_tss_desc.reserved       = 0;
+	the_tss_desc.avail          = 0;
+	the_tss_desc.seg_lim_19_16  = TSS_SIZE & 0x000F0000;
+	the_tss_desc.present        = 1;
+	the_tss_desc.dpl            = 0x0;
+	the_tss_desc.sys            = 0;
+	the_tss_desc.type           = 0x9;
+	the_tss_desc.seg_lim_15_00  = TSS_SIZE & 0x0000FFFF;
+
+	SET_TSS_PARAMS(the_tss_desc, cpu->tss, tss_size);
+	cpu_tss_desc_ptr[cpu->id - 1] = the_tss_desc;
+
+	cpu->tss->ldt_segment_selector = KERNEL_LDT;
+	cpu->tss->ss0 = KERNEL_DS;
+	cpu->tss->esp0 = (uint32_t)cpu_stack[cpu->id] + STACK_SIZE;
+	ltr(cpu->tss_sel);
+}
+
+/* Read the MP configuration table and fill in cpus[] */
+static int32_t
+mp_config(void)
+{
+	mp_float_t* mpf;
+	mp_config_t* conf;
+	mp_processor_t* proc;
+	mp_bus_t* bus;
+	mp_ioint_t* ioint;
+	uint8_t* entry;
+	uint32_t i, redir_flags;
+	uint32_t isa_bus = (uint32_t)-1;
+	cpu_t* cpu;
+
+	mpf = mp_search(MP_SCAN_BASEMEM, MP_SCAN_BASEMEM + 1024);
+	if (mpf == NULL)
+		mpf = mp_search(MP_SCAN_BIOS, MP_SCAN_BIOS_END);
+
+	/* Only tables inside the identity-mapped first 4MB can be read */
+	if (mpf == NULL || mpf->config_addr == 0 || mpf->config_addr >= KERNEL_ADDR)
+		return -1;
+
+	conf = (mp_config_t*)mpf->config_addr;
+	if (conf->signature != MP_CONFIG_SIG || mp_checksum((uint8_t*)conf, conf->base_len) != 0)
+		return -1;
+
+	lapic = (volatile uint32_t*)conf->lapic_addr;
+	mp_imcr_present = (mpf->features[1] & MP_IMCR_PRESENT) != 0;
+	num_cpus = 1;
+
+	entry = (uint8_t*)conf + sizeof(mp_config_t);
+	for (i = 0; i < conf->entry_count; i++) {
+		switch (*entry) {
+			case MP_ENTRY_BUS:
+				bus = (mp_bus_t*)entry;
+				if (strncmp((int8_t*)bus->bus_type, (int8_t*)"ISA", 3) == 0)
+					isa_bus = bus->bus_id;
+				break;
+			case MP_ENTRY_IOAPIC:
+				if (((mp_ioapic_t*)entry)->flags & MP_IOAPIC_ENABLED)
+					ioapic_add(((mp_ioapic_t*)entry)->addr);
+				break;
+			case MP_ENTRY_IOINT:
+				ioint = (mp_ioint_t*)entry;
+				if (ioint->irq_type != MP_IRQ_TYPE_INT || ioint->src_bus != isa_bus)
+					break;
+				redir_flags = 0;
+				if ((ioint->flags & MP_IRQ_POLARITY_MASK) == MP_IRQ_ACTIVE_LOW)
+					redir_flags |= REDIR_ACTIVE_LOW;
+				if ((ioint->flags & MP_IRQ_TRIGGER_MASK) == MP_IRQ_LEVEL)
+					redir_flags |= REDIR_LEVEL;
+				ioapic_isa_route(ioint->src_irq, ioint->dst_pin, redir_flags);
+				break;
+			default:
+				break;
+		}
+
+		if (*entry != MP_ENTRY_PROCESSOR) {
+			entry += MP_OTHER_LEN;
+			continue;
+		}
+
+		proc = (mp_processor_t*)entry;
+		entry += MP_PROCESSOR_LEN;
+
+		if (!(proc->flags & MP_CPU_ENABLED))
+			continue;
+
+		/* Keep the boot processor as CPU 0 */
+		if (proc->flags & MP_CPU_BSP)
+			cpu = &cpus[0];
+		else if (num_cpus < MAX_CPUS)
+			cpu = &cpus[num_cpus++];
+		else
+			continue;
+
+		cpu->apic_id = proc->apic_id;
+	}
+
+	return 0;
+}
+
+/* Send INIT and STARTUP IPIs to one processor and wait for it to check in */
+static void
+cpu_start(cpu_t* cpu)
+{
+	uint32_t i;
+
+	ap_boot_stack = (uint32_t)cpu_stack[cpu->id] + STACK_SIZE;
+	STACK_CPU(cpu_stack[cpu->id]) = cpu;
+
+	lapic_send_ipi(cpu->apic_id, ICR_INIT | ICR_LEVEL_ASSERT);
+	io_delay(INIT_DELAY);
+
+	/* The MP spec asks for the STARTUP IPI twice */
+	for (i = 0; i < 2; i++) {
+		lapic_send_ipi(cpu->apic_id, ICR_STARTUP | TRAMPOLINE_VECTOR);
+		io_delay(SIPI_DELAY);
+	}
+
+	for (i = 0; i < AP_WAIT_LOOPS && !cpu->online; i++)
+		io_delay(1);
+}
+
+/*
+ * smp_init
+ *   DESCRIPTION: Sets up per-CPU data for the boot processor, then starts
+ *                every other processor listed in the MP table
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: copies the trampoline to TRAMPOLINE_ADDR
+ */
+void
+smp_init(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < MAX_CPUS; i++) {
+		cpus[i].id = i;
+		cpus[i].tss = (i == 0) ? &tss : &cpu_tss[i];
+		cpus[i].tss_sel = (i == 0) ? KERNEL_TSS : CPU_TSS_BASE + ((i - 1) << 3);
+		cpus[i].current = NULL;
+		cpus[i].rq.lock = SPIN_LOCK_UNLOCKED;
+	}
+
+	/* The boot stack is the one pid 0 will run on */
+	STACK_CPU(&i) = &cpus[0];
+
+	/* Uniprocessor machine, or no table we can use */
+	if (mp_config() == -1) {
+		lapic = NULL;
+		num_cpus = 1;
+		cpus[0].online = 1;
+		return;
+	}
+
+	lapic_init();
+	cpus[0].apic_id = lapic_id();
+	cpus[0].online = 1;
+
+	/* Copy trampoline to low memory and hand it the kernel GDT */
+	memcpy((void*)TRAMPOLINE_ADDR, smp_trampoline_start, smp_trampoline_end - smp_trampoline_start);
+	asm volatile("sgdt (%0)"
+			:
+			: "r" (TRAMPOLINE_ADDR + (ap_gdt_arg - smp_trampoline_start))
+			: "memory");
+
+	for (i = 1; i < num_cpus; i++)
+		cpu_start(&cpus[i]);
+
+	printf("SMP: %d of %d CPUs online\n", smp_online(), num_cpus);
+}
+
+/* Number of processors that have checked in */
+uint32_t
+smp_online(void)
+{
+	uint32_t i, n = 0;
+
+	for (i = 0; i < num_cpus; i++)
+		n += cpus[i].online;
+
+	return n;
+}
+
+/*
+ * ap_main
+ *   DESCRIPTION: C entry point of an application processor, called from
+ *                smp_boot.S on its own boot stack with paging enabled
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: never returns
+ *   SIDE EFFECTS: loads this CPU's TSS, enables its local APIC and idles
+ */
+void
+ap_main(void)
+{
+	cpu_t* cpu = this_cpu();
+
+	cpu_load_tss(cpu);
+	lapic_init();
+	cpu->apic_id = lapic_id();
+	fpu_init();
+	cpu->online = 1;
+
+	cpu_idle();
+}
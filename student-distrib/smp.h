@@ -0,0 +1,158 @@
+/* smp.h - Defines for multiprocessor bring-up and per-CPU data
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "types.h"
+#include "x86_desc.h"
+
+#define STACK_SIZE 8192		// Kernel stacks, aligned to their size
+
+/* AP startup trampoline is copied to this real-mode address; the SIPI
+ * vector is its page number */
+#define TRAMPOLINE_ADDR 0x8000
+#define TRAMPOLINE_VECTOR (TRAMPOLINE_ADDR >> 12)
+
+/* MP floating pointer and configuration table */
+#define MP_FLOAT_SIG 0x5F504D5F		// "_MP_"
+#define MP_CONFIG_SIG 0x504D4350	// "PCMP"
+#define MP_SCAN_BASEMEM 0x0009FC00	// Last KB of base memory
+#define MP_SCAN_BIOS 0x000F0000		// BIOS ROM
+#define MP_SCAN_BIOS_END 0x00100000
+#define MP_ENTRY_PROCESSOR 0
+#define MP_ENTRY_BUS 1
+#define MP_ENTRY_IOAPIC 2
+#define MP_ENTRY_IOINT 3
+#define MP_PROCESSOR_LEN 20
+#define MP_OTHER_LEN 8
+#define MP_CPU_ENABLED 0x01
+#define MP_CPU_BSP 0x02
+#define MP_IOAPIC_ENABLED 0x01
+#define MP_IMCR_PRESENT 0x80		// features[1], 8259 routed through the IMCR
+#define MP_IRQ_TYPE_INT 0			// Vectored interrupt through the IOAPIC
+#define MP_IRQ_POLARITY_MASK 0x3
+#define MP_IRQ_ACTIVE_LOW 0x3
+#define MP_IRQ_TRIGGER_MASK 0xC
+#define MP_IRQ_LEVEL 0xC
+
+#ifndef ASM
+
+#include "sched.h"
+
+/* MP floating pointer structure */
+typedef struct __attribute__((packed)) mp_float_t {
+	uint32_t signature;
+	uint32_t config_addr;
+	uint8_t length;
+	uint8_t spec_rev;
+	uint8_t checksum;
+	uint8_t features[5];
+} mp_float_t;
+
+/* MP configuration table header */
+typedef struct __attribute__((packed)) mp_config_t {
+	uint32_t signature;
+	uint16_t base_len;
+	uint8_t spec_rev;
+	uint8_t checksum;
+	uint8_t oem_id[8];
+	uint8_t product_id[12];
+	uint32_t oem_table;
+	uint16_t oem_table_size;
+	uint16_t entry_count;
+	uint32_t lapic_addr;
+	uint16_t ext_len;
+	uint8_t ext_checksum;
+	uint8_t reserved;
+} mp_config_t;
+
+/* Processor entry of the MP configuration table */
+typedef struct __attribute__((packed)) mp_processor_t {
+	uint8_t type;
+	uint8_t apic_id;
+	uint8_t apic_ver;
+	uint8_t flags;
+	uint32_t signature;
+	uint32_t features;
+	uint32_t reserved[2];
+} mp_processor_t;
+
+/* Bus entry of the MP configuration table */
+typedef struct __attribute__((packed)) mp_bus_t {
+	uint8_t type;
+	uint8_t bus_id;
+	uint8_t bus_type[6];
+} mp_bus_t;
+
+/* I/O APIC entry of the MP configuration table */
+typedef struct __attribute__((packed)) mp_ioapic_t {
+	uint8_t type;
+	uint8_t apic_id;
+	uint8_t apic_ver;
+	uint8_t flags;
+	uint32_t addr;
+} mp_ioapic_t;
+
+/* I/O interrupt assignment entry of the MP configuration table */
+typedef struct __attribute__((packed)) mp_ioint_t {
+	uint8_t type;
+	uint8_t irq_type;
+	uint16_t flags;
+	uint8_t src_bus;
+	uint8_t src_irq;
+	uint8_t dst_apic;
+	uint8_t dst_pin;
+} mp_ioint_t;
+
+/* Per-CPU data */
+typedef struct cpu_t {
+	uint32_t id;				// Logical CPU number
+	uint32_t apic_id;
+	volatile uint32_t online;
+	tss_t* tss;
+	uint16_t tss_sel;
+	struct pcb_t* current;		// Process running on this CPU, NULL when idle
+	struct pcb_t* prev;			// Process switched away from, until finish_switch
+	uint32_t idle_ksp;			// Saved stack of the idle loop
+	volatile uint32_t ticks;	// Local APIC timer interrupts taken
+	struct pcb_t* fpu_owner;	// Process whose FPU state is in the registers
+	run_queue_t rq;
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+extern uint32_t num_cpus;
+/* Set when the 8259 has to be disconnected through the IMCR */
+extern uint32_t mp_imcr_present;
+
+/* Every kernel stack starts with the cpu_t of the CPU running on it: the
+ * PCB's stack_cpu on a process stack, set by whoever switches to it */
+#define STACK_CPU(addr) (*(cpu_t**)((uint32_t)(addr) & ~(STACK_SIZE - 1)))
+
+/* Per-CPU data of the calling processor */
+static inline cpu_t*
+this_cpu(void)
+{
+	uint32_t esp;
+
+	asm("movl %%esp, %0" : "=r" (esp));
+	return STACK_CPU(esp);
+}
+
+/* Find the other processors and start them */
+void smp_init(void);
+/* Number of processors that have checked in */
+uint32_t smp_online(void);
+/* C entry point of an application processor */
+void ap_main(void);
+
+/* Trampoline code in smp_boot.S */
+extern uint8_t smp_trampoline_start[];
+extern uint8_t smp_trampoline_end[];
+extern uint8_t ap_gdt_arg[];
+extern uint32_t ap_boot_stack;
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
@@ -0,0 +1,143 @@
+/* softirq.c - Deferred interrupt work (tasklets)
+ * vim:ts=4 noexpandtab
+ */
+
+#include "softirq.h"
+#include "smp.h"
+#include "lib.h"
+
+/* Tasklets queued on each CPU, and whether it is already running them */
+static tasklet_t* softirq_pending[MAX_CPUS];
+static uint32_t softirq_running[MAX_CPUS];
+
+/* Every tasklet queued since boot, newest first */
+static tasklet_t* tasklets;
+static uint32_t nr_tasklets;
+static spinlock_t tasklet_lock = SPIN_LOCK_UNLOCKED;
+
+/*
+ * tasklet_schedule
+ *   DESCRIPTION: Queues a tasklet on the calling CPU unless it is already
+ *                queued. Must be called with interrupts disabled.
+ *   INPUTS: tasklet_t* t - tasklet to run
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ */
+void
+tasklet_schedule(tasklet_t* t)
+{
+	uint32_t cpu = this_cpu()->id;
+
+	if (test_and_set(&t->pending))
+		return;
+
+	if (!t->listed) {
+		spin_lock(&tasklet_lock);
+		if (!t->listed) {
+			t->all_next = tasklets;
+			tasklets = t;
+			nr_tasklets++;
+			t->listed = 1;
+		}
+		spin_unlock(&tasklet_lock);
+	}
+
+	t->pending = 1;
+	t->queued_at = rdtsc();
+	t->next = softirq_pending[cpu];
+	softirq_pending[cpu] = t;
+}
+
+/*
+ * do_softirq
+ *   DESCRIPTION: Runs the tasklets queued on this CPU with interrupts
+ *                enabled, until none are left. Interrupts taken meanwhile
+ *                only queue more work; they do not run it themselves. A
+ *                tasklet still running on another CPU, queued here again
+ *                after it cleared pending, is put back for the next pass.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: returns with interrupts disabled
+ */
+void
+do_softirq(void)
+{
+	uint32_t cpu = this_cpu()->id;
+	uint32_t latency;
+	tasklet_t* list;
+	tasklet_t* t;
+
+	if (softirq_running[cpu] || softirq_pending[cpu] == NULL)
+		return;
+
+	softirq_running[cpu] = 1;
+	while ((list = softirq_pending[cpu]) != NULL) {
+		softirq_pending[cpu] = NULL;
+		sti();
+
+		while (list != NULL) {
+			t = list;
+			list = t->next;
+
+			if (test_and_set(&t->running)) {
+				cli();
+				t->next = softirq_pending[cpu];
+				softirq_pending[cpu] = t;
+				sti();
+				continue;
+			}
+
+			latency = rdtsc() - t->queued_at;
+			t->runs++;
+			t->total_latency += latency;
+			if (latency > t->max_latency)
+				t->max_latency = latency;
+
+			/* May be queued again from here on */
+			t->pending = 0;
+			t->func(t->data);
+			t->running = 0;
+		}
+
+		cli();
+	}
+	softirq_running[cpu] = 0;
+}
+
+/*
+ * syscall_softirqstat
+ *   DESCRIPTION: Copies the name and latency counters of each tasklet
+ *                queued since boot to user space
+ *   INPUTS: softirq_stat_t* buf - array to fill
+ *           int32_t n - number of entries in buf
+ *   OUTPUTS: one entry per tasklet, up to n
+ *   RETURN VALUE: number of tasklets, -1 on a bad buffer
+ */
+int32_t
+syscall_softirqstat(softirq_stat_t* buf, int32_t n)
+{
+	tasklet_t* t;
+	int32_t i, count;
+	uint32_t flags;
+
+	if (buf == NULL || n < 0)
+		return -1;
+
+	/* Tasklets are only ever added at the head, so the list from a
+	 * snapshot of it can be walked (and buf faulted in) without the lock */
+	spin_lock_irqsave(&tasklet_lock, flags);
+	t = tasklets;
+	count = nr_tasklets;
+	spin_unlock_irqrestore(&tasklet_lock, flags);
+
+	for (i = 0; t != NULL && i < n; t = t->all_next, i++) {
+		strncpy(buf[i].name, (const int8_t*)t->name, TASKLET_NAME_LEN - 1);
+		buf[i].name[TASKLET_NAME_LEN - 1] = '\0';
+		buf[i].runs = t->runs;
+		buf[i].total_latency = t->total_latency;
+		buf[i].max_latency = t->max_latency;
+	}
+
+	return count;
+}
@@ -0,0 +1,51 @@
+/* softirq.h - Deferred interrupt work (tasklets) run after the IRQ with
+ * interrupts enabled
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SOFTIRQ_H
+#define _SOFTIRQ_H
+
+#include "types.h"
+
+/* Work queued by an interrupt handler. A tasklet is queued at most once
+ * at a time and runs on the CPU that queued it, never on two CPUs at
+ * once. */
+typedef struct tasklet_t {
+	const char* name;
+	void (*func)(void* data);
+	void* data;
+
+	volatile uint32_t pending;
+	volatile uint32_t running;	// Set while some CPU is in func
+	uint32_t queued_at;			// rdtsc() when queued
+	struct tasklet_t* next;
+	struct tasklet_t* all_next;	// Every tasklet ever queued, for softirqstat
+	uint32_t listed;
+
+	/* Latency from tasklet_schedule to the start of func, in TSC cycles */
+	uint32_t runs;
+	uint32_t total_latency;
+	uint32_t max_latency;
+} tasklet_t;
+
+#define TASKLET_INIT(n, f, d) { .name = (n), .func = (f), .data = (d) }
+
+#define TASKLET_NAME_LEN 16
+
+/* Latency counters of one tasklet, as in ece391syscall.h */
+typedef struct softirq_stat_t {
+	int8_t name[TASKLET_NAME_LEN];
+	uint32_t runs;
+	uint32_t total_latency;
+	uint32_t max_latency;
+} softirq_stat_t;
+
+/* Queue a tasklet on the calling CPU, called from interrupt handlers */
+void tasklet_schedule(tasklet_t* t);
+/* Run queued tasklets with interrupts enabled, called on IRQ exit */
+void do_softirq(void);
+/* Copy the latency counters of up to n tasklets to user space */
+int32_t syscall_softirqstat(softirq_stat_t* buf, int32_t n);
+
+#endif /* _SOFTIRQ_H */
@@ -1,174 +1,509 @@
 #include "syscall.h"
 
-static int32_t pid = -1;
-pcb_t* process0_pcb = PROCESS0_PCB;
-pcb_t* process1_pcb = PROCESS1_PCB;
-pcb_t* current_pcb;
+/* Process slots in use, and slots that have ever held a process */
+static uint32_t pid_used = 0;
+static uint32_t pid_seen = 0;
+static spinlock_t pid_lock = SPIN_LOCK_UNLOCKED;
+
+pcb_t* foreground_pcb = NULL;
+
+/* Open files of every process; descriptors point into this table and
+ * share an entry after dup or execute */
+static file_desc_t open_files[MAX_OPEN_FILES];
+static uint32_t open_files_map[MAX_OPEN_FILES / 32];	// Bit set for every entry in use
+static spinlock_t file_lock = SPIN_LOCK_UNLOCKED;
+
+/* Chunks of descriptor tables, handed to processes as their tables grow */
+static fd_chunk_t fd_pool[FD_POOL_CHUNKS];
+static uint32_t fd_pool_map[(FD_POOL_CHUNKS + 31) / 32];
+static spinlock_t fd_pool_lock = SPIN_LOCK_UNLOCKED;
 
 /* Operations Table */
-ops_t file_ops = {.open=file_open, .close=file_close, .read=file_read, .write=file_write};
-ops_t dir_ops = {.open=dir_open, .close=dir_close, .read=dir_read, .write=dir_write};
-ops_t rtc_ops = {.open=rtc_open, .close=rtc_close, .read=rtc_read, .write=rtc_write};
-ops_t stdin_ops = {.open=term_open, .close=term_close, .read=term_read, .write=NULL};
-ops_t stdout_ops = {.open=NULL, .close=NULL, .read=NULL, .write=term_write};
+ops_t file_ops = {.open=file_open, .close=file_close, .read=file_read, .write=file_write, .poll=file_poll};
+ops_t dir_ops = {.open=dir_open, .close=dir_close, .read=dir_read, .write=dir_write, .poll=file_poll};
+ops_t rtc_ops = {.open=rtc_open, .close=rtc_close, .read=rtc_read, .write=rtc_write, .poll=rtc_poll};
+ops_t stdin_ops = {.open=term_open, .close=term_close, .read=term_read, .write=NULL, .poll=term_poll};
+ops_t stdout_ops = {.open=NULL, .close=NULL, .read=NULL, .write=term_write, .poll=term_write_poll, .writev=term_writev};
+
+/*
+* static int32_t alloc_pid()
+*	Inputs: none
+*	Return Value: free process slot, -1 if every slot is taken
+*	Function: Claims a process slot. A slot released by wait is only
+*			  reused once no CPU is still running on its kernel stack.
+*/
+static int32_t alloc_pid() {
+	int32_t pid;
+	uint32_t flags;
+
+	spin_lock_irqsave(&pid_lock, flags);
+	for (pid = 0; pid < MAX_PROCESSES; pid++) {
+		if (pid_used & (1 << pid))
+			continue;
+		if ((pid_seen & (1 << pid)) && PROCESS_PCB(pid)->on_cpu)
+			continue;
+
+		pid_used |= (1 << pid);
+		pid_seen |= (1 << pid);
+		spin_unlock_irqrestore(&pid_lock, flags);
+		return pid;
+	}
+	spin_unlock_irqrestore(&pid_lock, flags);
+
+	return -1;
+}
+
+/*
+* static void free_pid(int32_t pid)
+*	Inputs: int32_t pid = process slot to release
+*	Return Value: none
+*	Function: Returns a process slot claimed by alloc_pid
+*/
+static void free_pid(int32_t pid) {
+	uint32_t flags;
+
+	spin_lock_irqsave(&pid_lock, flags);
+	pid_used &= ~(1 << pid);
+	spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/*
+* static void orphan_children(pcb_t* proc)
+*	Inputs: pcb_t* proc = halting process
+*	Return Value: none
+*	Function: Nobody is left to wait for proc's background children.
+*			  Zombies are released now; the others lose their parent and
+*			  release their own slot when they halt. A slot reused by a
+*			  new process then never looks like their parent.
+*/
+static void orphan_children(pcb_t* proc) {
+	pcb_t* p;
+	int32_t pid;
+	uint32_t flags;
+
+	spin_lock_irqsave(&pid_lock, flags);
+	for (pid = 0; pid < MAX_PROCESSES; pid++) {
+		p = PROCESS_PCB(pid);
+		if (!(pid_used & (1 << pid)) || p == proc || p->parent_process != proc)
+			continue;
+
+		if (p->state == TASK_ZOMBIE)
+			pid_used &= ~(1 << pid);
+		else
+			p->parent_process = NULL;
+	}
+	spin_unlock_irqrestore(&pid_lock, flags);
+}
+
+/*
+* static file_desc_t* file_alloc()
+*	Inputs: none
+*	Return Value: open file with one reference and everything else
+*				  cleared, NULL if the table is full
+*	Function: Claims the first free entry of the open file table
+*/
+static file_desc_t* file_alloc() {
+	file_desc_t* file;
+	uint32_t i, flags;
+
+	spin_lock_irqsave(&file_lock, flags);
+	i = find_first_zero(open_files_map, MAX_OPEN_FILES);
+	if (i == MAX_OPEN_FILES) {
+		spin_unlock_irqrestore(&file_lock, flags);
+		return NULL;
+	}
+	open_files_map[i / 32] |= (1 << (i % 32));
+	spin_unlock_irqrestore(&file_lock, flags);
+
+	file = &open_files[i];
+	memset(file, 0, sizeof(file_desc_t));
+	file->refcount = 1;
+	file->inode_num = -1;
+	file->flags = IN_USE;
+	return file;
+}
+
+/* Return an open file with no descriptors left to the table */
+static void file_free(file_desc_t* file) {
+	uint32_t i = file - open_files;
+	uint32_t flags;
+
+	spin_lock_irqsave(&file_lock, flags);
+	file->ops = NULL;
+	file->flags = FREE_;
+	file->refcount = 0;
+	open_files_map[i / 32] &= ~(1 << (i % 32));
+	spin_unlock_irqrestore(&file_lock, flags);
+}
+
+/* Take another reference to an open file */
+static void file_get(file_desc_t* file) {
+	uint32_t flags;
+
+	spin_lock_irqsave(&file_lock, flags);
+	file->refcount++;
+	spin_unlock_irqrestore(&file_lock, flags);
+}
+
+/*
+* static int32_t fd_install(pcb_t* proc, int32_t fd, file_desc_t* file)
+*	Inputs: pcb_t* proc = process whose table gets the descriptor
+*			int32_t fd = closed descriptor, below FD_MAX
+*			file_desc_t* file = open file it will refer to
+*	Return Value: fd, -1 if no chunk was left to grow the table
+*	Function: Grows the table up to fd, taking chunks from the pool, and
+*			  points fd at file. The caller passes on its reference.
+*/
+static int32_t fd_install(pcb_t* proc, int32_t fd, file_desc_t* file) {
+	fd_table_t* table = &proc->files;
+	uint32_t c, flags;
+
+	while (fd >= table->size) {
+		spin_lock_irqsave(&fd_pool_lock, flags);
+		c = find_first_zero(fd_pool_map, FD_POOL_CHUNKS);
+		if (c < FD_POOL_CHUNKS)
+			fd_pool_map[c / 32] |= (1 << (c % 32));
+		spin_unlock_irqrestore(&fd_pool_lock, flags);
+
+		if (c == FD_POOL_CHUNKS)
+			return -1;
+
+		memset(&fd_pool[c], 0, sizeof(fd_chunk_t));
+		table->chunk[table->size / FD_CHUNK] = &fd_pool[c];
+		table->size += FD_CHUNK;
+	}
+
+	table->chunk[fd / FD_CHUNK]->file[fd % FD_CHUNK] = file;
+	table->open[fd / 32] |= (1 << (fd % 32));
+	return fd;
+}
+
+/*
+* static int32_t fd_alloc(pcb_t* proc, file_desc_t* file)
+*	Inputs: pcb_t* proc = process whose table gets the descriptor
+*			file_desc_t* file = open file it will refer to
+*	Return Value: lowest closed descriptor, now referring to file, or -1
+*	Function: Finds the descriptor in the open bitmap a word at a time
+*/
+static int32_t fd_alloc(pcb_t* proc, file_desc_t* file) {
+	uint32_t fd = find_first_zero(proc->files.open, FD_MAX);
+
+	if (fd == FD_MAX)
+		return -1;
+	return fd_install(proc, fd, file);
+}
+
+/*
+* static void fd_close(pcb_t* proc, int32_t fd)
+*	Inputs: pcb_t* proc = process owning fd, the caller or its new child
+*			int32_t fd = open descriptor
+*	Return Value: none
+*	Function: Empties the slot and drops its reference. The backend close
+*			  runs when the last descriptor of the file goes, and only
+*			  then is the entry free for reuse.
+*/
+static void fd_close(pcb_t* proc, int32_t fd) {
+	fd_table_t* table = &proc->files;
+	file_desc_t* file = table->chunk[fd / FD_CHUNK]->file[fd % FD_CHUNK];
+	uint32_t flags, last;
+
+	spin_lock_irqsave(&file_lock, flags);
+	last = (file->refcount == 1);
+	if (!last)
+		file->refcount--;
+	spin_unlock_irqrestore(&file_lock, flags);
+
+	if (last && file->ops->close != NULL)
+		file->ops->close(fd);
+	table->chunk[fd / FD_CHUNK]->file[fd % FD_CHUNK] = NULL;
+	table->open[fd / 32] &= ~(1 << (fd % 32));
+
+	if (last)
+		file_free(file);
+}
+
+/*
+* file_desc_t* get_file(int32_t fd)
+*	Inputs: int32_t fd = descriptor of the calling process
+*	Return Value: its open file, NULL if fd is out of range or not open
+*	Function: Looks a descriptor up
+*/
+file_desc_t* get_file(int32_t fd) {
+	fd_table_t* table = &current_pcb->files;
+
+	if (fd < 0 || fd >= table->size)
+		return NULL;
+	return table->chunk[fd / FD_CHUNK]->file[fd % FD_CHUNK];
+}
+
+/*
+* void process_halt(uint32_t status)
+*	Inputs: uint32_t status = exit status, KILLED_STATUS for a process
+*				killed by an exception
+*	Return Value: none, does not return
+*	Function: Releases the calling process's files and heap, then either
+*			  leaves it as a zombie for wait (background) or resumes the
+*			  parent's execute, which returns status
+*/
+void process_halt(uint32_t status) {
+	pcb_t* child = current_pcb;
+	pcb_t* parent = child->parent_process;
+	uint32_t flags;
 
-int32_t syscall_halt(uint8_t status) {
 	/* If halting initial shell process */
-	if (current_pcb->pid == 0) {
+	if (child->pid == 0) {
 		printf("Shutting down OS\n");
 		while(1) {
 			asm("hlt");
 		}
 	}
+
+	/* Its background children can no longer be waited for */
+	orphan_children(child);
+
+	/* Close every descriptor, files shared with others stay open */
+	release_files(child);
 	
+	/* Release heap frames of halting process, all of them lie below the break */
+	if (child->heap_brk != HEAP_VIRT_ADDR) {
+		heap_trim(child->pid, HEAP_VIRT_ADDR);
+		child->heap_brk = HEAP_VIRT_ADDR;
+	}
+	child->status = status;
+
+	/* Unmap the program image, its FPU state is not needed any more */
+	elf_release(child);
+	fpu_release(child);
+
+	/* Background process: stay a zombie until the parent waits for it, or
+	 * release the slot at once if the parent halted first. Decided under
+	 * pid_lock so a halting parent sees either a zombie or a live child. */
+	if (child->background) {
+		spin_lock_irqsave(&pid_lock, flags);
+		set_current_state(TASK_ZOMBIE);
+		if (child->parent_process == NULL)
+			pid_used &= ~(1 << child->pid);
+		else
+			sched_wake(child->parent_process);
+		spin_unlock_irqrestore(&pid_lock, flags);
+		schedule();
+	}
+
+	cli();
+
 	/* Change TSS to use parent's kernel stack on syscalls */
-	tss.esp0 = PROCESS0_KERNEL_STACK;
-	//current_pcb->file_array[fd].ops->close(fd);
+	this_cpu()->tss->esp0 = PROCESS_KERNEL_STACK(parent->pid);
 
 	/* Load parent's page directory */
 	asm volatile("movl %0, %%cr3"
 	: /* no outputs */
-	: "r" (process0_dir) /* inputs */
+	: "r" (parent->p_dir) /* inputs */
+	: "memory"
 	);
 	
-	current_pcb = process0_pcb;
-	
-	return 0;
+	current_pcb = parent;
+	foreground_pcb = parent;
+	parent->stack_cpu = this_cpu();
+	free_pid(child->pid);
+
+	/* The slot stays reserved through on_cpu until we are off its stack */
+	return_to_parent(child->esp, status, &child->on_cpu);
+}
+
+/*
+* int32_t syscall_halt(uint8_t status)
+*	Inputs: uint8_t status = exit status, only the low byte of EBX
+*	Return Value: does not return
+*	Function: Terminates the calling process
+*/
+int32_t syscall_halt(uint8_t status) {
+	process_halt(status);
+	return -1;
 }
 
 int32_t syscall_execute(const uint8_t* command) {
-	uint8_t cmd[NAME_LEN];
-	int32_t* p_dir;
-	pid++;	
-	/* Check for max number of processes */
-	if (pid >= 2)
+	uint8_t line[BUFFER_SIZE];
+	uint8_t cmd[NAME_LEN + 1];
+	pcb_t* parent = current_pcb;
+	pcb_t* child;
+	file_desc_t* file;
+	int32_t pid;
+	uint32_t background = 0;
+	uint32_t* ksp;
+
+	if (command == NULL)
 		return -1;
-	
-	/* Set current PCB depending on pid */
-	switch (pid) {
-		case 0:
-			current_pcb = PROCESS0_PCB;
-			current_pcb->pid = pid;
-			current_pcb->p_dir = (uint32_t*)process0_dir;
-			current_pcb->parent_process = NULL;
-			break;
-		case 1:
-			current_pcb = PROCESS1_PCB;
-			current_pcb->pid = pid;
-			current_pcb->p_dir = (uint32_t*)process1_dir;
-			current_pcb->parent_process = PROCESS0_PCB;
-			break;
-		default:
-			return -1;
-	}
-	
-	/* Initialize stdin and stdout */
-	init_stds(current_pcb);
 
-	/* Parse command line and separate arguments */
+	/* Copy command line, a trailing '&' starts the program in the background */
 	uint32_t i = 0;
 	uint32_t j = 0;
 	uint32_t entry_point;
+
+	while (i < BUFFER_SIZE - 1 && command[i] != '\0') {
+		line[i] = command[i];
+		i++;
+	}
+	while (i > 0 && line[i - 1] == ' ')
+		i--;
+	if (i > 0 && line[i - 1] == BACKGROUND_CHAR) {
+		background = 1;
+		i--;
+		while (i > 0 && line[i - 1] == ' ')
+			i--;
+	}
+	line[i] = '\0';
 	
-	while (command[i] != '\0') {
-		if (command[i] == ' ') {
-			while (command[i] == ' ') {
-				i++;
-			}
-			while (command[i] != '\0') {
-				current_pcb->arg[j] = command[i];
-				i++;
-				j++;
-			}
-			current_pcb->arg[j] = '\0';
-			break;
-		}
-		cmd[i] = command[i];
+	/* Parse command line and separate command name */
+	i = 0;
+	while (line[i] != '\0' && line[i] != ' ' && i < NAME_LEN) {
+		cmd[i] = line[i];
 		i++;
 	}
+	cmd[i] = '\0';
+	while (line[i] != '\0' && line[i] != ' ')
+		i++;
+	while (line[i] == ' ')
+		i++;
 	
-	/* Open file and check for valid magic */
-	uint8_t prog[4];
 	dentry_t temp;
 	
 	/* Get directory entry associated with command name */
 	if (read_dentry_by_name((uint8_t*)cmd, &temp) == -1)
 		return -1;
+
+	/* Check for max number of processes */
+	pid = alloc_pid();
+	if (pid == -1)
+		return -1;
 	
-	/* Read data from inode number of directory entry */
-	read_data(temp.inode_num, 0, prog, 4);//read_file_length(temp.inode_num));
-	
-	/* Enable page directory for process 0 */
-	//process0_dir[PROG_VIRT_ADDR >> PD_SHIFT] |= P_FLAG;
+	/* Set up PCB of the new process */
+	child = PROCESS_PCB(pid);
+	child->stack_cpu = this_cpu();
+	child->pid = pid;
+	child->p_dir = (uint32_t*)process_dir[pid];
+	child->parent_process = parent;
+	child->state = TASK_RUNNING;
+	child->cpu = this_cpu()->id;
+	child->on_cpu = 0;
+	child->last_ran = 0;
+	child->migrations = 0;
+	child->background = background;
+	child->status = 0;
+	child->sig_pending = 0;
+	child->sig_blocked = 0;
+	child->fpu_used = 0;
+	for (j = 0; j < NUM_SIGNALS; j++)
+		child->sig_handler[j] = 0;
+
+	/* Copy arguments */
+	for (j = 0; line[i] != '\0'; i++, j++)
+		child->arg[j] = line[i];
+	child->arg[j] = '\0';
+	
+	/* Inherit the parent's descriptors, the first process gets stdin and stdout */
+	memset(&child->files, 0, sizeof(fd_table_t));
+	for (j = 0; parent != NULL && j < parent->files.size; j++) {
+		file = parent->files.chunk[j / FD_CHUNK]->file[j % FD_CHUNK];
+		if (file == NULL)
+			continue;
+		if (fd_install(child, j, file) == -1) {
+			release_files(child);
+			free_pid(pid);
+			return -1;
+		}
+		file_get(file);
+	}
+	if (parent == NULL)
+		init_stds(child);
+
+	/* Start with an empty heap, halt left no frames in the slot */
+	child->heap_brk = HEAP_VIRT_ADDR;
 
-	/* Checks for magic number */
-	if ((prog[0] != INITIAL_BYTE) || (prog[1] != E) || (prog[2] != L) || (prog[3] != F))
+	/* Check the ELF headers, the image is paged in as it is touched */
+	if (elf_load(child, temp.inode_num, &entry_point) == -1) {
+		release_files(child);
+		free_pid(pid);
 		return -1;
+	}
+
+	if (background) {
+		/* Build the kernel stack switch_to expects: its saved registers and
+		 * return into new_process_entry, then the iret frame to user mode */
+		ksp = (uint32_t*)PROCESS_KERNEL_STACK(pid);
+		*(--ksp) = USER_DS;
+		*(--ksp) = USER_STACK;
+		*(--ksp) = FLAGS;
+		*(--ksp) = USER_CS;
+		*(--ksp) = entry_point;
+		*(--ksp) = (uint32_t)new_process_entry;
+		*(--ksp) = 0;	// ebp
+		*(--ksp) = 0;	// ebx
+		*(--ksp) = 0;	// esi
+		*(--ksp) = 0;	// edi
+		*(--ksp) = 0;	// flags, interrupts stay off until iret
+		child->ksp = (uint32_t)ksp;
+
+		if (sched_enqueue(sched_pick_cpu(), child) == -1) {
+			elf_release(child);
+			release_files(child);
+			free_pid(pid);
+			return -1;
+		}
+
+		return pid;
+	}
 	
-	/* Enable respective page directories */
-	switch (pid) {
-		case 0:
-			process0_dir[PROCESS0_KERNEL_STACK >> PD_SHIFT] |= P_FLAG;
-			p_dir = process0_dir;
-			break;
-		case 1:
-			process1_dir[PROCESS1_KERNEL_STACK >> PD_SHIFT] |= P_FLAG;
-			p_dir = process1_dir;
-			break;
-		default:
-			break;
-	}	
+	/* Foreground: the new process takes over this CPU */
+	fpu_switch_out(parent);
+	child->on_cpu = 1;
+	current_pcb = child;
+	foreground_pcb = child;
+
+	/* Change TSS of this CPU */
+	this_cpu()->tss->ss0 = KERNEL_DS;
+	this_cpu()->tss->esp0 = PROCESS_KERNEL_STACK(pid);
+
 	/* Load page directory into CR3 */
 	asm volatile("movl %0, %%cr3"
 	: /* no outputs */
-	: "r" (p_dir) /* inputs */
+	: "r" (child->p_dir) /* inputs */
+	: "memory"
 	);
 	
-	//current_pcb->file_array[fd].ops->open(fd);!!!!!!!!!!!
-	//term_open(0);
-	//sti();
-	/* Read executable image into virtual memory 128MB */
-	read_data(temp.inode_num, 0, (uint8_t*)(PROG_IMG_ADDR), read_file_length(temp.inode_num));
-	
-	/* Double check for magic and file copied correctly */
-	if ((*(uint8_t*)(PROG_IMG_ADDR) != INITIAL_BYTE) || (*(uint8_t*)(PROG_IMG_ADDR + 1) != E) || (*(uint8_t*)(PROG_IMG_ADDR + 2) != L)
-		|| (*(uint8_t*)(PROG_IMG_ADDR + 3) != F))
+	/* Run it until it halts; its exit status is the return value */
+	return enter_user(&child->esp, entry_point, USER_STACK, FLAGS);
+}
+
+/*
+* int32_t syscall_wait(int32_t pid)
+*	Inputs: int32_t pid = background process started by the caller
+*	Return Value: exit status of the process, -1 if pid is not a
+*				  background child of the caller
+*	Function: Blocks until the child halts and releases its slot
+*/
+int32_t syscall_wait(int32_t pid) {
+	pcb_t* child;
+	int32_t status;
+
+	if (pid <= 0 || pid >= MAX_PROCESSES || !(pid_used & (1 << pid)))
 		return -1;
-	
-	/* Get entry point in bytes 24 - 27 of executable */
-	read_data(temp.inode_num, 24, (uint8_t*)&entry_point, 4);
-	
-	/* Change TSS */
-	tss.ss0 = KERNEL_DS;
-	switch (pid) {
-		case PROC0:
-			tss.esp0 = PROCESS0_KERNEL_STACK;
-			break;
-		case PROC1:
-			tss.esp0 = PROCESS1_KERNEL_STACK;
-			break;
-		default:
+
+	child = PROCESS_PCB(pid);
+	if (child->parent_process != current_pcb || !child->background)
+		return -1;
+
+	while (1) {
+		set_current_state(TASK_BLOCKED);
+		if (child->state == TASK_ZOMBIE)
 			break;
+		schedule();
 	}
-	
-	/* Save current process stack pointer */
-	current_pcb->esp = (uint32_t)&command;
-	
-	/* IRET to switch to privilege level 3 */
-	asm volatile(
-		"pushl %0\n\t"
-		"pushl %1\n\t"
-		"pushl %4\n\t"
-		"pushl %2\n\t"
-		"pushl %3\n\t"
-		"movl %0, %%ds\n\t"
-		"iret\n\t"
-		:
-		: "r"(USER_DS), "r"(USER_STACK), "r"(USER_CS), "r"(entry_point), "r"(FLAGS)
-		: "memory", "cc"
-		);
-		
-	return 0;
+	set_current_state(TASK_RUNNING);
+
+	status = child->status;
+	free_pid(pid);
+
+	return status;
 }
 
 /* 
@@ -182,19 +517,13 @@ int32_t syscall_execute(const uint8_t* command) {
 *				RTC, directory, and keyboard
 */
 int32_t syscall_read(int32_t fd, void* buf, int32_t nbytes) {
-	/* Check for valid file descriptor */
-	if (fd < STDIN_FILE || fd > MAX_FILES-1)
-		return -1;
-	
-	/* Check if stdout */
-	if (fd == STDOUT_FILE)
-		return -1;
-	
-	/* Check if file descriptor has been initialized */
-	if (current_pcb->file_array[fd].flags == FREE_)
+	file_desc_t* file = get_file(fd);
+
+	/* Check for an open descriptor that can be read (not stdout) */
+	if (file == NULL || file->ops->read == NULL)
 		return -1;
 
-	return current_pcb->file_array[fd].ops->read(fd, buf, nbytes);
+	return file->ops->read(fd, buf, nbytes);
 }
 
 /* 
@@ -207,127 +536,344 @@ int32_t syscall_read(int32_t fd, void* buf, int32_t nbytes) {
 *	Function: Write system call that writes data to terminal or RTC
 */
 int32_t syscall_write(int32_t fd, const void* buf, int32_t nbytes) {
-	/* Check for valid file descriptor */
-	if (fd < STDIN_FILE || fd > MAX_FILES-1)
-		return -1;
+	file_desc_t* file = get_file(fd);
 
-	/* Check if stdin */
-	if (fd == STDIN_FILE)
+	/* Check for an open descriptor that can be written (not stdin) */
+	if (file == NULL || file->ops->write == NULL)
 		return -1;
 		
-	/* Check if file descriptor has been initialized */
-	if (current_pcb->file_array[fd].flags == FREE_)
+	return file->ops->write(fd, buf, nbytes);//term_write(fd,buf,nbytes)
+}
+
+/*
+* int32_t syscall_poll(pollfd_t* fds, int32_t nfds, int32_t timeout)
+*	Inputs: pollfd_t* fds = descriptors to watch and the events of each
+*			int32_t nfds = number of entries in fds
+*			int32_t timeout = timer ticks to wait, 0 to only test and
+*							  negative to wait without limit
+*	Return Value: number of entries with revents set, 0 on timeout,
+*				  -1 on bad arguments or if a signal ended the wait
+*	Function: Asks the backend of every descriptor which events are ready,
+*			  sleeping on all of their wait queues at once until one is
+*/
+int32_t syscall_poll(pollfd_t* fds, int32_t nfds, int32_t timeout) {
+	pollfd_t pfd[POLL_MAX_FDS];
+	poll_table_t pt;
+	poll_table_t* wait = (timeout == 0) ? NULL : &pt;
+	file_desc_t* file;
+	uint32_t deadline = cpus[0].ticks + timeout;
+	uint32_t mask;
+	int32_t i, ready;
+
+	if (fds == NULL || nfds < 0 || nfds > POLL_MAX_FDS)
 		return -1;
-		
-	return current_pcb->file_array[fd].ops->write(fd, buf, nbytes);//term_write(fd,buf,nbytes)
+	memcpy(pfd, fds, nfds * sizeof(pollfd_t));
+
+	poll_init(&pt);
+	if (timeout > 0)
+		poll_wait(&tick_wq, &pt);
+
+	while (1) {
+		/* Blocked before testing, so a wakeup in between is not lost */
+		set_current_state(TASK_BLOCKED);
+
+		ready = 0;
+		for (i = 0; i < nfds; i++) {
+			pfd[i].revents = 0;
+			if (pfd[i].fd < 0)
+				continue;
+
+			if ((file = get_file(pfd[i].fd)) == NULL) {
+				mask = POLLNVAL;
+			} else {
+				mask = file->ops->poll(pfd[i].fd, wait);
+				mask &= pfd[i].events | POLLERR | POLLHUP;
+			}
+
+			pfd[i].revents = mask;
+			if (mask)
+				ready++;
+		}
+
+		/* Queues are joined on the first pass only */
+		wait = NULL;
+
+		if (ready || timeout == 0 || signal_pending(current_pcb))
+			break;
+		if (timeout > 0 && (int32_t)(cpus[0].ticks - deadline) >= 0)
+			break;
+		poll_schedule(&pt);
+	}
+	set_current_state(TASK_RUNNING);
+	poll_free(&pt);
+
+	if (!ready && signal_pending(current_pcb))
+		return -1;
+
+	for (i = 0; i < nfds; i++)
+		fds[i].revents = pfd[i].revents;
+
+	return ready;
+}
+
+/*
+* int32_t syscall_fcntl(int32_t fd, int32_t cmd, int32_t arg)
+*	Inputs: int32_t fd = open file descriptor
+*			int32_t cmd = F_GETFL or F_SETFL
+*			int32_t arg = new flags for F_SETFL
+*	Return Value: flags for F_GETFL, 0 for F_SETFL, -1 on failure
+*	Function: Reads or changes the status flags of a descriptor; only
+*			  O_NONBLOCK can be changed
+*/
+int32_t syscall_fcntl(int32_t fd, int32_t cmd, int32_t arg) {
+	file_desc_t* file = get_file(fd);
+
+	if (file == NULL)
+		return -1;
+
+	switch (cmd) {
+		case F_GETFL:
+			return file->flags & FD_SETFL_MASK;
+		case F_SETFL:
+			file->flags = (file->flags & ~FD_SETFL_MASK) | (arg & FD_SETFL_MASK);
+			return 0;
+		default:
+			return -1;
+	}
+}
+
+/*
+* int32_t syscall_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+*	Inputs: int32_t fd = file descriptor
+*			const iovec_t* iov = buffers to fill in order
+*			int32_t iovcnt = number of entries in iov
+*	Return Value: total bytes read, -1 on failure
+*	Function: Reads into each buffer in turn, stopping after a short read
+*/
+int32_t syscall_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+	iovec_t kiov[IOV_MAX];
+	int32_t i, ret, total = 0;
+
+	if (iov == NULL || iovcnt < 0 || iovcnt > IOV_MAX)
+		return -1;
+	memcpy(kiov, iov, iovcnt * sizeof(iovec_t));
+
+	for (i = 0; i < iovcnt; i++) {
+		if ((ret = syscall_read(fd, kiov[i].base, kiov[i].len)) < 0)
+			return (total > 0) ? total : ret;
+		total += ret;
+		if (ret < kiov[i].len)
+			break;
+	}
+
+	return total;
+}
+
+/*
+* int32_t syscall_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+*	Inputs: int32_t fd = file descriptor
+*			const iovec_t* iov = buffers to write in order
+*			int32_t iovcnt = number of entries in iov
+*	Return Value: total bytes written, -1 on failure
+*	Function: Writes each buffer in turn, or all of them at once through
+*			  the backend's writev
+*/
+int32_t syscall_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt) {
+	iovec_t kiov[IOV_MAX];
+	file_desc_t* file = get_file(fd);
+	ops_t* ops;
+	int32_t i, ret, total = 0;
+
+	if (iov == NULL || iovcnt < 0 || iovcnt > IOV_MAX)
+		return -1;
+	if (file == NULL || file->ops->write == NULL)
+		return -1;
+	memcpy(kiov, iov, iovcnt * sizeof(iovec_t));
+
+	ops = file->ops;
+	if (ops->writev != NULL)
+		return ops->writev(fd, kiov, iovcnt);
+
+	for (i = 0; i < iovcnt; i++) {
+		if ((ret = ops->write(fd, kiov[i].base, kiov[i].len)) < 0)
+			return (total > 0) ? total : ret;
+		total += ret;
+		if (ret < kiov[i].len)
+			break;
+	}
+
+	return total;
 }
 
 /* int32_t syscall_open(const uint8_t* filename)
 *	Inputs: const uint8_t* filename = name of the file
-*	Return Value: 0 upon successful close, otherwise -1
-*	Function: Open the file
+*	Return Value: new file descriptor, the lowest one free, or -1
+*	Function: Open the file in a new entry of the open file table
 */
 int32_t syscall_open(const uint8_t* filename) {
 	dentry_t temp;
+	file_desc_t* file;
 	int32_t fd;
-	int32_t i;
 	
 	/* Checks whether file exists */
-	if (read_dentry_by_name(filename, &temp) == -1)
-		return -4;
-		
-	/* Clear file arrays */
-	for (i = REGULAR_FILE_START; i < MAX_FILES; i++) {
-		current_pcb->file_array[i].ops = 0;
-		current_pcb->file_array[i].inode_num = -1;
-		current_pcb->file_array[i].file_pos = 0;
-		current_pcb->file_array[i].flags = 0;
-	}
+	if (filename == NULL || read_dentry_by_name(filename, &temp) == -1)
+		return -1;
 	
-	/* Find unused file descriptor */
-	for (fd = REGULAR_FILE_START; fd < MAX_FILES+1; fd++) {
-		/* Check for end of file array */
-		if (fd == MAX_FILES)
-			return -3;
-			
-		/* Found unused file descriptor */
-		if (current_pcb->file_array[fd].flags == FREE_);
-			break;
-	}
+	if ((file = file_alloc()) == NULL)
+		return -1;
 	
 	/* Setup and call respective open functions based on file type */
 	switch(temp.f_type) {
 		case TYPE_RTC:
-				current_pcb->file_array[fd].ops = &rtc_ops;
-				rtc_open(fd);
+				file->ops = &rtc_ops;
 				break;
 		case TYPE_DIR:
-				current_pcb->file_array[fd].ops = &dir_ops;
-				dir_open(fd);
+				file->ops = &dir_ops;
 				break;
 		case TYPE_FILE:
-				current_pcb->file_array[fd].ops = &file_ops;
-				current_pcb->file_array[fd].inode_num = temp.inode_num;
-				file_open(fd);
+				file->ops = &file_ops;
+				file->inode_num = temp.inode_num;
 				break;
 		default:
-				current_pcb->file_array[fd].ops = &stdin_ops;
-				term_open(fd);
+				file->ops = &stdin_ops;
 				break;
 	}
 	
-	/* Initialize stdin and stdout */
-	init_stds(current_pcb);
+	/* Lowest unused file descriptor, dropping the file if there is none */
+	if ((fd = fd_alloc(current_pcb, file)) == -1) {
+		file_free(file);
+		return -1;
+	}
+	file->ops->open(fd);
 	
-	return 0;
+	return fd;
 }
 
 /* int32_t syscall_close(int32_t fd)
 *	Inputs: int32_t fd = file descriptor
 *	Return Value: 0 upon successful close, otherwise -1
-*	Function: Close the file
+*	Function: Close the file, which stays open through other descriptors
+*			  (after dup or execute) until the last one is closed. stdin
+*			  and stdout cannot be closed, only replaced with dup2.
 */
 int32_t syscall_close(int32_t fd) {
 	/* Check for stdin/stdout fd */
-	if (fd == (STDIN_FILE || STDOUT_FILE)) {
+	if (fd == STDIN_FILE || fd == STDOUT_FILE)
 		return -1;
-	}
 	
 	/* Check if file is actually open */
-	if(current_pcb->file_array[fd].flags == FREE_) {
+	if (get_file(fd) == NULL)
 		return -1;
-	}
 	
-	/* Reset/erase data in file descriptor */
-	current_pcb->file_array[fd].ops = NULL;
-	current_pcb->file_array[fd].inode_num = -1;
-	current_pcb->file_array[fd].file_pos = NULL;
-	current_pcb->file_array[fd].flags = FREE_;
+	fd_close(current_pcb, fd);
 	
 	return 0;
 }
 
+/* int32_t syscall_dup(int32_t fd)
+*	Inputs: int32_t fd = open file descriptor
+*	Return Value: new descriptor, the lowest one free, or -1
+*	Function: Makes a second descriptor for the same open file, sharing
+*			  its position and flags
+*/
+int32_t syscall_dup(int32_t fd) {
+	file_desc_t* file = get_file(fd);
+	int32_t newfd;
+	
+	if (file == NULL)
+		return -1;
+	
+	if ((newfd = fd_alloc(current_pcb, file)) == -1)
+		return -1;
+	file_get(file);
+	
+	return newfd;
+}
+
+/* int32_t syscall_dup2(int32_t fd, int32_t newfd)
+*	Inputs: int32_t fd = open file descriptor
+*			int32_t newfd = descriptor to make refer to the same file
+*	Return Value: newfd, or -1
+*	Function: Like dup, but with the descriptor chosen by the caller,
+*			  closing whatever newfd had open first
+*/
+int32_t syscall_dup2(int32_t fd, int32_t newfd) {
+	file_desc_t* file = get_file(fd);
+	
+	if (file == NULL || newfd < 0 || newfd >= FD_MAX)
+		return -1;
+	if (newfd == fd)
+		return newfd;
+	
+	/* An open newfd is covered by the table already, so only a closed one
+	 * can fail for want of a chunk */
+	if (get_file(newfd) != NULL)
+		fd_close(current_pcb, newfd);
+	if (fd_install(current_pcb, newfd, file) == -1)
+		return -1;
+	file_get(file);
+	
+	return newfd;
+}
+
+/*
+* void init_stds(pcb_t* cur_pcb)
+*	Inputs: pcb_t* cur_pcb = first process, with no descriptors yet
+*	Return Value: none
+*	Function: Opens the terminal as its stdin and stdout
+*/
 void init_stds(pcb_t* cur_pcb) {
-	/* Initialize stdin of current PCB's file array */
-	cur_pcb->file_array[STDIN_FILE].ops = &stdin_ops;
-	cur_pcb->file_array[STDIN_FILE].inode_num = -1;
-	cur_pcb->file_array[STDIN_FILE].file_pos = 0;
-	cur_pcb->file_array[STDIN_FILE].flags = IN_USE;
-	
-	/* Initialize stdout of current PCB's file array */
-	cur_pcb->file_array[STDOUT_FILE].ops = &stdout_ops;
-	cur_pcb->file_array[STDOUT_FILE].inode_num = -1;
-	cur_pcb->file_array[STDOUT_FILE].file_pos = 0;
-	cur_pcb->file_array[STDOUT_FILE].flags = IN_USE;
+	file_desc_t* file;
+	
+	/* Initialize stdin of current PCB's file table */
+	if ((file = file_alloc()) != NULL) {
+		file->ops = &stdin_ops;
+		if (fd_install(cur_pcb, STDIN_FILE, file) == -1)
+			file_free(file);
+	}
+	
+	/* Initialize stdout of current PCB's file table */
+	if ((file = file_alloc()) != NULL) {
+		file->ops = &stdout_ops;
+		if (fd_install(cur_pcb, STDOUT_FILE, file) == -1)
+			file_free(file);
+	}
+}
+
+/*
+* void release_files(pcb_t* proc)
+*	Inputs: pcb_t* proc = process that halts, or that a failed execute
+*				set up
+*	Return Value: none
+*	Function: Closes every descriptor and returns the table's chunks to
+*			  the pool
+*/
+void release_files(pcb_t* proc) {
+	fd_table_t* table = &proc->files;
+	uint32_t fd, c, flags;
+	
+	for (fd = 0; fd < table->size; fd++) {
+		if (table->chunk[fd / FD_CHUNK]->file[fd % FD_CHUNK] != NULL)
+			fd_close(proc, fd);
+	}
+	
+	spin_lock_irqsave(&fd_pool_lock, flags);
+	for (c = 0; c < table->size / FD_CHUNK; c++) {
+		fd = table->chunk[c] - fd_pool;
+		fd_pool_map[fd / 32] &= ~(1 << (fd % 32));
+		table->chunk[c] = NULL;
+	}
+	spin_unlock_irqrestore(&fd_pool_lock, flags);
+	table->size = 0;
 }
 
 /*
- * getargs
+ * syscall_getargs
  *   DESCRIPTION: Reads command line arguments into user-level buffer
  *   INPUTS: uint8_t* buf - buffer to write into, int32_t nbytes - length of buffer
  *   OUTPUTS: none
  */
-int32_t getargs (uint8_t* buf, int32_t nbytes)
+int32_t syscall_getargs(uint8_t* buf, int32_t nbytes)
 {
 	/* Check for non-existent buff */
 	if (buf == NULL)
@@ -354,12 +900,12 @@ int32_t getargs (uint8_t* buf, int32_t nbytes)
 }
 
 /*
- * vidmap
+ * syscall_vidmap
  *   DESCRIPTION: Maps text-mode video memory into user space
  *   INPUTS: uint8_t** screen_start - pointer to address of video memory virtual address
  *   OUTPUTS: none (address stored in location from screen_start)
  */
-int32_t vidmap (uint8_t** screen_start)
+int32_t syscall_vidmap(uint8_t** screen_start)
 {
 	/* Check if valid pointer
 	 * input is a pointer to a pointer which points to video memory virtual address
@@ -383,3 +929,32 @@ int32_t vidmap (uint8_t** screen_start)
 	return 0;
 }
 
+
+/*
+ * syscall_sbrk
+ *   DESCRIPTION: Moves the program break of the current process. Pages
+ *                between the old and new break are not mapped here, they
+ *                are zero-filled by the page fault handler on first touch.
+ *   INPUTS: int32_t increment - number of bytes to grow (or shrink) the heap
+ *   OUTPUTS: none
+ *   RETURN VALUE: previous break on success, -1 if outside the heap region
+ */
+int32_t syscall_sbrk(int32_t increment)
+{
+	uint32_t old_brk = current_pcb->heap_brk;
+	uint32_t new_brk = old_brk + increment;
+
+	/* Check new break stays inside the heap page table */
+	if ((increment < 0 && new_brk > old_brk) || (increment > 0 && new_brk < old_brk))
+		return -1;
+	if (new_brk < HEAP_VIRT_ADDR || new_brk > HEAP_VIRT_ADDR + HEAP_MAX_SIZE)
+		return -1;
+
+	/* Give back frames above the new break */
+	if (new_brk < old_brk)
+		heap_trim(current_pcb->pid, new_brk);
+
+	current_pcb->heap_brk = new_brk;
+
+	return old_brk;
+}
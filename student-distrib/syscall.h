@@ -14,16 +14,30 @@
 #include "usermode.h"
 #include "x86_desc.h"
 #include "lib.h"
+#include "smp.h"
+#include "signal.h"
+#include "elf.h"
+#include "fpu.h"
 
 /* General */
-#define MAX_FILES 8
+#define FD_CHUNK 8			// Descriptors per chunk of a process's table
+#define FD_MAX 64			// Most descriptors one process can have open
+#define FD_CHUNKS (FD_MAX / FD_CHUNK)
+#define FD_POOL_CHUNKS 32	// Table chunks shared by every process
 #define STDIN_FILE 0
 #define REGULAR_FILE_START 2
 #define STDOUT_FILE 1
-#define MAX_PROCESSES 2
+#define MAX_PROCESSES 6
+#define MAX_OPEN_FILES 128	// Entries in the open file table
 #define IN_USE 1
 #define FREE_ 0
-#define STACK_SIZE 8192
+#define O_NONBLOCK 0x0800	// file_desc_t flag: reads that would block fail with -EAGAIN
+#define FD_SETFL_MASK O_NONBLOCK	// Flags F_SETFL may change
+#define EAGAIN 11			// Returned negated by a non-blocking read with nothing ready
+
+/* fcntl commands */
+#define F_GETFL 3
+#define F_SETFL 4
 #define VID_VIRT_ADDR 0x08400000	// virtual address for video memory
 
 /* Magic Numbers */
@@ -38,23 +52,29 @@
 #define OFFSET 0x00048000
 #define USER_STACK 0x08400000 // PROG_VIRT_ADDR + 4MB
 
-#define PROC0 0
-#define PROC1 1
-
 #define FLAGS 0x246
 
-/* Process 0 */
-#define PROCESS0_PHYS_ADDR 0x00800000 // Physical address 8MB
-#define PROCESS0_KERNEL_STACK 0x00800000
-#define PROCESS0_PCB (pcb_t*)0x007FE000 // Physical address 8MB - 8KB
-#define PROCESS0_OFFSET_ADDR (PROCESS0_PHYS_ADDR + OFFSET) // Offset within page for copy of program image
+/* Process slots. Slot n owns the 4MB page at physical 8MB + 4MB*n and the
+ * 8KB kernel stack ending at 8MB - 8KB*n, with its PCB at the bottom. */
+#define PROCESS_BASE_ADDR 0x00800000 // Physical address 8MB
+#define PROCESS_PAGE_SIZE 0x00400000
+#define PROCESS_PHYS_ADDR(pid) (PROCESS_BASE_ADDR + (pid) * PROCESS_PAGE_SIZE)
+#define PROCESS_KERNEL_STACK(pid) (PROCESS_BASE_ADDR - (pid) * STACK_SIZE)
+#define PROCESS_PCB(pid) ((pcb_t*)(PROCESS_KERNEL_STACK(pid) - STACK_SIZE))
+#define PROCESS_OFFSET_ADDR(pid) (PROCESS_PHYS_ADDR(pid) + OFFSET) // Offset within page for copy of program image
+
+#define POLL_MAX_FDS 16	// Descriptors one poll call can watch
+#define IOV_MAX 16		// Segments one readv or writev call can take
+
+#define BACKGROUND_CHAR '&'	// Trailing character of a command run without waiting
+#define KILLED_STATUS 256	// Returned by execute when the program died from an exception
 
-/* Process 1 */
-#define PROCESS1_PHYS_ADDR 0x00C00000 // Physical address 12MB
-#define PROCESS1_KERNEL_STACK 0x007FE000 // Physical address 8KB above bottom of 4MB
-#define PROCESS1_PCB (pcb_t*)0x007FC000 // Physical address 8MB - 16KB
-#define PROCESS1_OFFSET_ADDR (PROCESS1_PHYS_ADDR + OFFSET) // Offset within page for copy of program image
 
+/* Buffer segment of readv and writev, as in ece391syscall.h */
+typedef struct iovec_t {
+	void* base;
+	uint32_t len;
+} iovec_t;
 
 /* Operations Table */
 typedef struct ops_t {
@@ -62,31 +82,85 @@ typedef struct ops_t {
 	int32_t (*close) (int32_t fd);
 	int32_t (*read)(int32_t fd, void* buf, int32_t length);
 	int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
+	poll_fn_t poll;		// POLL* bits ready, joins the backend's wait queues
+	int32_t (*writev)(int32_t fd, const iovec_t* iov, int32_t iovcnt);	// NULL to write each segment
 } ops_t;
 
-/* File Descriptor struct */
+/* Descriptor watched by poll, as in ece391syscall.h */
+typedef struct pollfd_t {
+	int32_t fd;			// Negative entries are skipped
+	uint16_t events;	// POLLIN and POLLOUT bits to watch for
+	uint16_t revents;	// Ready bits, with POLLERR, POLLHUP or POLLNVAL
+} pollfd_t;
+
+/* Open file, shared by every descriptor dup'ed from it or inherited
+ * through execute */
 typedef struct file_desc_t{
+	uint32_t refcount;	// Descriptors referring to it, 0 when the entry is free
 	ops_t* ops;
 	uint32_t inode_num;
 	uint32_t file_pos;
-	uint32_t flags;
+	uint32_t flags;		// IN_USE, or FREE_ for an unused entry, plus O_NONBLOCK
+	uint32_t ra_next;	// file_pos a sequential read would start at
+	uint32_t ra_window;	// Blocks read ahead of file_pos, 0 after a seek
 }file_desc_t;
 
+/* Part of a descriptor table, NULL for a closed descriptor */
+typedef struct fd_chunk_t {
+	file_desc_t* file[FD_CHUNK];
+} fd_chunk_t;
+
+/* Descriptor table of a process. It starts empty and takes another chunk
+ * from the shared pool whenever the lowest free descriptor lies past the
+ * end, so most processes only hold one. */
+typedef struct fd_table_t {
+	uint32_t size;						// Descriptors covered by the chunks held
+	uint32_t open[FD_MAX / 32];			// Bit set for every open descriptor
+	fd_chunk_t* chunk[FD_CHUNKS];
+} fd_table_t;
+
 typedef struct pcb_t {
-	uint32_t esp;
-	uint32_t ebp;
-	uint32_t eip;
+	struct cpu_t* stack_cpu;	// CPU running on this kernel stack, must come first for this_cpu
+	uint32_t esp;		// Parent's kernel stack saved by enter_user, resumed on halt
 	
 	uint32_t pid;
 	uint32_t* p_dir;
-	file_desc_t file_array[MAX_FILES];
+	fd_table_t files;
 	uint8_t arg[BUFFER_SIZE];
 	struct pcb_t* parent_process;
+	uint32_t heap_brk;	// Current program break, heap spans HEAP_VIRT_ADDR to here
+
+	/* Program image, paged in by elf_fault */
+	uint32_t exe_inode;
+	image_t* image;		// Shared file pages, NULL if the cache was full
+	uint32_t nsegs;
+	elf_seg_t seg[MAX_SEGMENTS];
+
+	/* Scheduling */
+	uint32_t ksp;		// Kernel stack pointer saved by switch_to
+	uint32_t state;		// TASK_RUNNING, TASK_BLOCKED or TASK_ZOMBIE
+	uint32_t cpu;		// CPU the process last ran on
+	volatile uint32_t on_cpu;	// Set while some CPU is running on its kernel stack
+	uint32_t last_ran;	// Timer tick of its CPU when it was last switched out
+	uint32_t migrations;	// Times it was stolen by another CPU
+	uint32_t background;	// Started with '&', parent collects it with wait
+	uint32_t status;	// Exit status kept until the parent waits
+
+	/* Signals */
+	uint32_t sig_handler[NUM_SIGNALS];	// User handler addresses, 0 for the default action
+	uint32_t sig_pending;
+	uint32_t sig_blocked;	// All set while a handler runs
+
+	/* FPU, loaded on the first #NM after each switch */
+	uint32_t fpu_used;	// Has executed an FPU or SSE instruction
+	uint32_t fpu_cpu;	// CPU whose registers last held its state
+	uint8_t fpu_state[FPU_STATE_SIZE] __attribute__((aligned (16)));
 } pcb_t;
 
-extern pcb_t* current_pcb;
-extern pcb_t* process0_pcb;
-extern pcb_t* process1_pcb;
+/* Process running on the calling CPU */
+#define current_pcb (this_cpu()->current)
+/* Innermost foreground process, target of Ctrl+C */
+extern pcb_t* foreground_pcb;
 
 extern ops_t file_ops;
 extern ops_t dir_ops;
@@ -96,17 +170,28 @@ extern ops_t stdout_ops;
 
 /* System Calls */
 int32_t syscall_halt(uint8_t status);
+void process_halt(uint32_t status);
 int32_t syscall_execute(const uint8_t* command);
 int32_t syscall_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t syscall_write(int32_t fd, const void* buf, int32_t nbytes);
 int32_t syscall_open(const uint8_t* filename);
 int32_t syscall_close(int32_t fd);
-int32_t getargs (uint8_t* buf, int32_t nbytes);
-int32_t vidmap (uint8_t** screen_start);
+int32_t syscall_dup(int32_t fd);
+int32_t syscall_dup2(int32_t fd, int32_t newfd);
+int32_t syscall_getargs(uint8_t* buf, int32_t nbytes);
+int32_t syscall_vidmap(uint8_t** screen_start);
+int32_t syscall_sbrk(int32_t increment);
+int32_t syscall_wait(int32_t pid);
+int32_t syscall_poll(pollfd_t* fds, int32_t nfds, int32_t timeout);
+int32_t syscall_fcntl(int32_t fd, int32_t cmd, int32_t arg);
+int32_t syscall_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+int32_t syscall_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
 int32_t run_shell();
 
 /* Helper Functions */
 void init_stds(pcb_t* cur_pcb);
+void release_files(pcb_t* proc);
+file_desc_t* get_file(int32_t fd);
 void set_tss();
 
 #endif
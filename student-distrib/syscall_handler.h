@@ -9,6 +9,9 @@ extern int32_t syscall_read (int32_t fd, void* buf, int32_t nbytes);
 extern int32_t syscall_write (int32_t fd, const void* buf, int32_t nbytes);
 extern int32_t syscall_open (const uint8_t* filename);
 extern int32_t syscall_close (int32_t fd);
+extern int32_t syscall_sbrk (int32_t increment);
+extern int32_t syscall_wait (int32_t pid);
+extern int32_t syscall_set_handler (int32_t signum, void* handler_address);
 
 void system_call(void);
 
@@ -15,6 +15,10 @@
 #define USER_DS 0x002B //changed from 2b
 #define KERNEL_TSS 0x0030
 #define KERNEL_LDT 0x0038
+#define CPU_TSS_BASE 0x0040 // TSS selectors of CPUs 1 and up
+
+/* Number of processors supported */
+#define MAX_CPUS 4
 
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE 104
@@ -124,6 +128,7 @@ extern x86_desc_t lgdt_arg;
 extern uint32_t tss_size;
 extern seg_desc_t tss_desc_ptr;
 extern tss_t tss;
+extern seg_desc_t cpu_tss_desc_ptr[MAX_CPUS - 1];
 
 /* Sets runtime-settable parameters in the GDT entry for the LDT */
 #define SET_LDT_PARAMS(str, addr, lim) \
@@ -0,0 +1,79 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define NAMESIZE 33
+#define PASSES 2
+
+static void
+put_num (const char* label, uint32_t value)
+{
+    uint8_t buf[NAMESIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+/* Counters accumulated since "before" */
+static void
+put_stats (const bcache_stat_t* before, const bcache_stat_t* after)
+{
+    put_num ("hits ", after->hits - before->hits);
+    put_num (", misses ", after->misses - before->misses);
+    put_num (", read ahead ", after->readahead - before->readahead);
+    put_num (" (used ", after->ra_hits - before->ra_hits);
+    put_num ("), evictions ", after->evictions - before->evictions);
+    put_num (", writebacks ", after->writebacks - before->writebacks);
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/*
+ * Prints the disk buffer cache counters. Given a file name, reads the file
+ * sequentially PASSES times and prints what each pass cost the cache: the
+ * first pass from a cold cache mostly reads ahead, later ones only hit.
+ */
+int main ()
+{
+    uint8_t name[NAMESIZE];
+    uint8_t buf[BUFSIZE];
+    bcache_stat_t zero, before, after;
+    int32_t fd, cnt, pass;
+    uint32_t total;
+
+    if (-1 == ece391_bcachestat (&after)) {
+        ece391_fdputs (1, (uint8_t*)"bcachestat failed\n");
+        return 2;
+    }
+
+    if (0 != ece391_getargs (name, NAMESIZE) || '\0' == name[0]) {
+        put_num ("cache blocks ", after.blocks);
+        ece391_fdputs (1, (uint8_t*)"\nsince boot: ");
+        zero.hits = zero.misses = zero.readahead = 0;
+        zero.ra_hits = zero.evictions = zero.writebacks = 0;
+        put_stats (&zero, &after);
+        return 0;
+    }
+
+    for (pass = 1; pass <= PASSES; pass++) {
+        if (-1 == (fd = ece391_open (name))) {
+            ece391_fdputs (1, (uint8_t*)"file not found\n");
+            return 3;
+        }
+        ece391_bcachestat (&before);
+        total = 0;
+        while (0 < (cnt = ece391_read (fd, buf, BUFSIZE)))
+            total += cnt;
+        ece391_bcachestat (&after);
+        ece391_close (fd);
+
+        put_num ("pass ", pass);
+        put_num (": ", total);
+        ece391_fdputs (1, (uint8_t*)" bytes, ");
+        put_stats (&before, &after);
+    }
+
+    return 0;
+}
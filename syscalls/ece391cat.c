@@ -6,7 +6,9 @@
 int main ()
 {
     int32_t fd, cnt;
+    uint32_t left;
     uint8_t buf[1024];
+    stat_t st;
 
     if (0 != ece391_getargs (buf, 1024)) {
         ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
@@ -18,11 +20,22 @@ int main ()
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, 1024))) {
+    /* A regular file is read to its length with no trailing read to find
+       the end; anything else until read returns 0 */
+    if (-1 == ece391_fstat (fd, &st)) {
+        ece391_fdputs (1, (uint8_t*)"file stat failed\n");
+	return 3;
+    }
+    left = (TYPE_FILE == st.f_type) ? st.length : 0xFFFFFFFF;
+
+    for (; 0 != left; left -= cnt) {
+        cnt = ece391_read (fd, buf, (left < 1024) ? left : 1024);
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
 	    return 3;
 	}
+	if (0 == cnt)
+	    break;
 	if (-1 == ece391_write (1, buf, cnt))
 	    return 3;
     }
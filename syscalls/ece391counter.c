@@ -9,6 +9,7 @@ int main ()
 {
     uint32_t i, cnt, max = 0;
     uint8_t buf[BUFSIZE];
+    iovec_t out[2];
 
     ece391_fdputs(1, (uint8_t*)"Enter the Test Number: (0): 100, (1): 10000, (2): 100000\n");
     if (-1 == (cnt = ece391_read(0, buf, BUFSIZE-1)) ) {
@@ -34,10 +35,13 @@ int main ()
         }
     }
 
+    out[0].base = buf;
+    out[1].base = "\n";
+    out[1].len = 1;
     for (i = 0; i < max; i++) {
         ece391_itoa(i+1, buf, 10);
-        ece391_fdputs(1, buf);
-        ece391_fdputs(1, (uint8_t*)"\n");
+        out[0].len = ece391_strlen(buf);
+        (void)ece391_writev(1, out, 2);
     }
 
     return 0;
@@ -0,0 +1,89 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+#define MAX_CPUS 4
+#define DEFAULT_ROUNDS 1000
+#define RTC_HZ 2
+#define EXIT_STATUS 42
+
+static void
+put_num (const char* label, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+/* Timer tick count of CPU 0 */
+static uint32_t
+ticks (void)
+{
+    sched_stat_t st[MAX_CPUS];
+
+    if (-1 == ece391_schedstat (st, MAX_CPUS))
+        return 0;
+    return st[0].ticks;
+}
+
+/*
+ * Exec/halt microbenchmark. Runs "exit" in the foreground the given number
+ * of times (default 1000), checks that each execute returns the status
+ * byte the child halted with, and reports round trips per second. The
+ * timer tick rate is calibrated against one second of RTC interrupts.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t rounds = DEFAULT_ROUNDS;
+    uint32_t tick_hz, t0, t1, i;
+    int32_t rtc_fd, rate, garbage;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && buf[0] >= '1' && buf[0] <= '9') {
+        rounds = 0;
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            rounds = rounds * 10 + (buf[i] - '0');
+    }
+
+    /* Timer ticks in one second of RTC interrupts */
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open rtc\n");
+        return 2;
+    }
+    rate = RTC_HZ;
+    ece391_write (rtc_fd, &rate, 4);
+    ece391_read (rtc_fd, &garbage, 4);
+    t0 = ticks ();
+    for (i = 0; i < RTC_HZ; i++)
+        ece391_read (rtc_fd, &garbage, 4);
+    tick_hz = ticks () - t0;
+    ece391_close (rtc_fd);
+    if (tick_hz == 0) {
+        ece391_fdputs (1, (uint8_t*)"timer not running\n");
+        return 2;
+    }
+
+    t0 = ticks ();
+    for (i = 0; i < rounds; i++) {
+        if (EXIT_STATUS != ece391_execute ((uint8_t*)"exit 42")) {
+            put_num ("bad exit status in round ", i);
+            ece391_fdputs (1, (uint8_t*)"\n");
+            return 3;
+        }
+    }
+    t1 = ticks ();
+    if (t1 == t0)
+        t1++;
+
+    put_num ("round trips: ", rounds);
+    put_num (", ticks: ", t1 - t0);
+    put_num (", ticks per second: ", tick_hz);
+    put_num (", round trips per second: ", (rounds * tick_hz) / (t1 - t0));
+    ece391_fdputs (1, (uint8_t*)"\n");
+
+    return 0;
+}
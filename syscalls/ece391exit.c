@@ -0,0 +1,23 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+
+/*
+ * Halts at once with the status given as its argument (0 by default).
+ * Child program of the exec/halt benchmark.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t status = 0;
+    uint32_t i;
+
+    if (0 == ece391_getargs (buf, BUFSIZE))
+        for (i = 0; i < BUFSIZE && buf[i] >= '0' && buf[i] <= '9'; i++)
+            status = status * 10 + (buf[i] - '0');
+
+    return status;
+}
@@ -11,6 +11,7 @@ do_one_file (const char* s, const char* fname)
 {
     int32_t fd, cnt, last, line_start, line_end, check, s_len;
     uint8_t data[BUFSIZE+1];
+    iovec_t out[4];
 
     s_len = ece391_strlen ((uint8_t*)s);
     if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
@@ -42,10 +43,16 @@ do_one_file (const char* s, const char* fname)
 	    for (check = line_start; check < line_end; check++) {
 		if (s[0] == data[check] && 
 		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
+		    /* "fname:line\n" in one call */
+		    out[0].base = (void*)fname;
+		    out[0].len = ece391_strlen ((uint8_t*)fname);
+		    out[1].base = ":";
+		    out[1].len = 1;
+		    out[2].base = data + line_start;
+		    out[2].len = line_end - line_start;
+		    out[3].base = "\n";
+		    out[3].len = 1;
+		    (void)ece391_writev (1, out, 4);
 		    break;
 		}
 	    }
@@ -0,0 +1,101 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define ARGSIZE 40
+#define CMDSIZE 64
+#define NUM_READERS 4
+#define DISK 0
+
+static const char* files[NUM_READERS] = { "fish", "shell", "grep", "cat" };
+
+static void
+put_num (const char* label, uint32_t value)
+{
+    uint8_t buf[ARGSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+/* Reader mode: read one file to the end in BUFSIZE pieces */
+static int32_t
+read_file (const uint8_t* name)
+{
+    uint8_t buf[BUFSIZE];
+    int32_t fd;
+
+    if (-1 == (fd = ece391_open (name)))
+        return 1;
+    while (0 < ece391_read (fd, buf, BUFSIZE));
+    ece391_close (fd);
+    return 0;
+}
+
+/*
+ * I/O scheduler benchmark. "iobench noop" or "iobench deadline" switches
+ * the disk to that scheduler (which starts from a cold cache), reads
+ * NUM_READERS files concurrently with background copies of itself started
+ * as "iobench @file", then prints the request counters and the histogram
+ * of request latencies in TSC cycles.
+ */
+int main ()
+{
+    uint8_t arg[ARGSIZE];
+    uint8_t cmd[CMDSIZE];
+    int32_t pid[NUM_READERS];
+    io_stat_t st;
+    uint32_t i, n;
+
+    if (0 != ece391_getargs (arg, ARGSIZE) || '\0' == arg[0]) {
+        ece391_fdputs (1, (uint8_t*)"usage: iobench noop|deadline\n");
+        return 1;
+    }
+    if ('@' == arg[0])
+        return read_file (arg + 1);
+
+    if (-1 == ece391_iosched (DISK, arg)) {
+        ece391_fdputs (1, (uint8_t*)"no disk or no such scheduler\n");
+        return 2;
+    }
+
+    for (i = 0; i < NUM_READERS; i++) {
+        ece391_strcpy (cmd, (uint8_t*)"iobench @");
+        n = ece391_strlen (cmd);
+        ece391_strcpy (cmd + n, (uint8_t*)files[i]);
+        n = ece391_strlen (cmd);
+        ece391_strcpy (cmd + n, (uint8_t*)" &");
+        pid[i] = ece391_execute (cmd);
+    }
+    for (i = 0; i < NUM_READERS; i++) {
+        if (-1 != pid[i])
+            ece391_wait (pid[i]);
+    }
+
+    if (-1 == ece391_iostat (DISK, &st)) {
+        ece391_fdputs (1, (uint8_t*)"iostat failed\n");
+        return 3;
+    }
+
+    ece391_fdputs (1, (uint8_t*)st.sched);
+    put_num (": requests ", st.queued);
+    put_num (", merged blocks ", st.merged);
+    put_num (", sectors ", st.sectors);
+    put_num (", expired ", st.expired);
+    ece391_fdputs (1, (uint8_t*)"\nlatency (cycles < 2^n): ");
+    for (i = 0; i < IO_HIST_BUCKETS; i++) {
+        if (0 == st.hist[i])
+            continue;
+        if (i == IO_HIST_BUCKETS - 1)
+            ece391_fdputs (1, (uint8_t*)" more:");
+        else
+            put_num (" ", i + IO_HIST_SHIFT + 1);
+        put_num ("=", st.hist[i]);
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+
+    return 0;
+}
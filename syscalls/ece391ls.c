@@ -3,27 +3,41 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-#define SBUFSIZE 33
+#define MAXENTS 64
+#define OUTSIZE (MAXENTS * (DIRENT_NAME_LEN + 1))
+
+static dirent_t ents[MAXENTS];
+static uint8_t out[OUTSIZE];
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, i, len = 0;
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    /* A whole directory fits in one getdents, one name per line */
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
-	        return 3;
+	    for (i = 0; i < cnt / (int32_t)sizeof (dirent_t); i++) {
+	        if (len + DIRENT_NAME_LEN + 1 > OUTSIZE) {
+	            if (-1 == ece391_write (1, out, len))
+	                return 3;
+	            len = 0;
+	        }
+	        ece391_strcpy (out + len, ents[i].fname);
+	        len += ece391_strlen (ents[i].fname);
+	        out[len++] = '\n';
+	    }
     }
 
+    if (0 != len && -1 == ece391_write (1, out, len))
+        return 3;
+
     return 0;
 }
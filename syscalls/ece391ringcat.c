@@ -0,0 +1,82 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define NBUFS 16
+
+static io_ring_t ring;
+static uint8_t bufs[NBUFS][BUFSIZE];
+static int32_t lens[NBUFS];
+
+static void
+queue (uint32_t opcode, int32_t fd, void* buf, int32_t len, uint32_t user_data)
+{
+    io_sqe_t* sqe = &ring.sq[ring.sq_tail & IORING_MASK];
+
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->buf = buf;
+    sqe->len = len;
+    sqe->user_data = user_data;
+    ring.sq_tail++;
+}
+
+/* Submit everything queued and reap the results into lens, -1 on failure */
+static int32_t
+submit_and_reap (void)
+{
+    io_cqe_t* cqe;
+    uint32_t want = ring.sq_tail - ring.sq_head;
+
+    if (want != (uint32_t)ece391_ring_enter (&ring, want))
+        return -1;
+    while (ring.cq_head != ring.cq_tail) {
+        cqe = &ring.cq[ring.cq_head & IORING_MASK];
+        lens[cqe->user_data] = cqe->res;
+        ring.cq_head++;
+    }
+    return 0;
+}
+
+/*
+ * cat through the I/O rings: each round queues NBUFS reads of the file,
+ * then the writes of what they returned, so a round costs two traps
+ * instead of one per read and one per write.
+ */
+int main ()
+{
+    int32_t fd, i, n;
+    uint8_t name[BUFSIZE];
+
+    if (0 != ece391_getargs (name, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
+        return 3;
+    }
+
+    if (-1 == (fd = ece391_open (name))) {
+        ece391_fdputs (1, (uint8_t*)"file not found\n");
+        return 2;
+    }
+
+    do {
+        for (i = 0; i < NBUFS; i++)
+            queue (IORING_OP_READ, fd, bufs[i], BUFSIZE, i);
+        if (-1 == submit_and_reap ()) {
+            ece391_fdputs (1, (uint8_t*)"ring submit failed\n");
+            return 3;
+        }
+
+        for (n = 0; n < NBUFS && lens[n] > 0; n++)
+            queue (IORING_OP_WRITE, 1, bufs[n], lens[n], n);
+        if (n < NBUFS && -1 == lens[n]) {
+            ece391_fdputs (1, (uint8_t*)"file read failed\n");
+            return 3;
+        }
+        if (-1 == submit_and_reap ())
+            return 3;
+    } while (n == NBUFS);
+
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+#define MAX_WORKERS 4
+#define MAX_CPUS 4
+
+static void
+put_num (const char* label, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+/* Sum of steals and CPU 0's tick count */
+static int32_t
+sample (uint32_t* ticks, uint32_t* steals)
+{
+    sched_stat_t st[MAX_CPUS];
+    int32_t n, i;
+
+    if (-1 == (n = ece391_schedstat (st, MAX_CPUS)))
+        return -1;
+    *ticks = st[0].ticks;
+    *steals = 0;
+    for (i = 0; i < n && i < MAX_CPUS; i++)
+        *steals += st[i].steals;
+    return n;
+}
+
+/*
+ * Scaling benchmark for the work-stealing scheduler. For 1..N workers it
+ * starts N copies of "spin" in the background, waits for all of them and
+ * reports elapsed timer ticks, throughput (workers per 1000 ticks) and how
+ * many processes idle CPUs stole from busy ones.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    int32_t pid[MAX_WORKERS];
+    uint32_t max = MAX_WORKERS;
+    uint32_t n, i;
+    uint32_t t0, t1, s0, s1;
+    int32_t cpus;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && buf[0] >= '1' && buf[0] <= '9') {
+        max = buf[0] - '0';
+        if (max > MAX_WORKERS)
+            max = MAX_WORKERS;
+    }
+
+    if (-1 == (cpus = sample (&t0, &s0))) {
+        ece391_fdputs (1, (uint8_t*)"schedstat failed\n");
+        return 2;
+    }
+    put_num ("cpus online: ", cpus);
+    ece391_fdputs (1, (uint8_t*)"\n");
+
+    for (n = 1; n <= max; n++) {
+        sample (&t0, &s0);
+        for (i = 0; i < n; i++) {
+            if (-1 == (pid[i] = ece391_execute ((uint8_t*)"spin &"))) {
+                ece391_fdputs (1, (uint8_t*)"could not start spin\n");
+                return 3;
+            }
+        }
+        for (i = 0; i < n; i++)
+            ece391_wait (pid[i]);
+        sample (&t1, &s1);
+
+        if (t1 == t0)
+            t1++;
+        put_num ("workers ", n);
+        put_num (": ticks ", t1 - t0);
+        put_num (", per 1000 ticks ", (n * 1000) / (t1 - t0));
+        put_num (", steals ", s1 - s0);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+
+    return 0;
+}
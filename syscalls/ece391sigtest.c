@@ -7,8 +7,10 @@
 
 static uint8_t charbuf;
 static volatile uint8_t* badbuf = 0;
+static volatile int32_t zero = 0;
 void segfault_sighandler (int signum);
 void alarm_sighandler (int signum);
+void divzero_sighandler (int signum);
 
 int main ()
 {
@@ -26,6 +28,16 @@ int main ()
 		ece391_set_handler(ALARM, alarm_sighandler);
 	}
 
+	/* A fault inside a handler, where every signal is blocked, must kill
+	 * the program: the shell should report exit status 256 */
+	if (buf[0] == '2') {
+		ece391_fdputs(1, (uint8_t*)"Dividing by zero with a handler that divides by zero\n");
+		ece391_set_handler(DIV_ZERO, divzero_sighandler);
+		cnt = 1 / zero;
+		ece391_fdputs(1, (uint8_t*)"failure\n");
+		return cnt;
+	}
+
     ece391_fdputs (1, (uint8_t*)"Hi, what's your name? ");
     if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
         ece391_fdputs (1, (uint8_t*)"Can't read name from keyboard.\n");
@@ -79,3 +91,11 @@ alarm_sighandler (int signum)
         default: ece391_fdputs(1, (uint8_t*)"invalid\n"); break;
     }
 }
+
+void
+divzero_sighandler (int signum)
+{
+    ece391_fdputs(1, (uint8_t*)"Divide by zero handler called, dividing again\n");
+    zero = 1 / zero;
+    ece391_fdputs(1, (uint8_t*)"failure\n");
+}
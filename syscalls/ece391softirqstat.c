@@ -0,0 +1,51 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define MAXTASKLETS 16
+#define NUMSIZE 12
+
+static softirq_stat_t stats[MAXTASKLETS];
+
+static void
+put_num (const char* label, uint32_t value)
+{
+    uint8_t buf[NUMSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+/*
+ * Prints, for each tasklet queued since boot, how often it ran and its
+ * average and worst latency from the IRQ queueing it to the start of its
+ * work, in TSC cycles.
+ */
+int main ()
+{
+    int32_t cnt, i;
+
+    if (-1 == (cnt = ece391_softirqstat (stats, MAXTASKLETS))) {
+        ece391_fdputs (1, (uint8_t*)"softirqstat failed\n");
+        return 2;
+    }
+    if (0 == cnt) {
+        ece391_fdputs (1, (uint8_t*)"no tasklets have run\n");
+        return 0;
+    }
+    if (cnt > MAXTASKLETS)
+        cnt = MAXTASKLETS;
+
+    for (i = 0; i < cnt; i++) {
+        ece391_fdputs (1, (uint8_t*)stats[i].name);
+        put_num (": runs ", stats[i].runs);
+        put_num (", average latency ",
+                 (0 == stats[i].runs) ? 0 : stats[i].total_latency / stats[i].runs);
+        put_num (" cycles, max ", stats[i].max_latency);
+        ece391_fdputs (1, (uint8_t*)" cycles\n");
+    }
+
+    return 0;
+}
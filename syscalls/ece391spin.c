@@ -0,0 +1,32 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+#define DEFAULT_ROUNDS 2000
+
+/*
+ * CPU-bound worker for the scaling benchmark: runs a fixed number of
+ * rounds of integer work without making system calls, so it can only be
+ * moved between processors by the scheduler.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t rounds = DEFAULT_ROUNDS;
+    uint32_t i, j;
+    volatile uint32_t x = 1;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && buf[0] >= '0' && buf[0] <= '9') {
+        rounds = 0;
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            rounds = rounds * 10 + (buf[i] - '0');
+    }
+
+    for (i = 0; i < rounds; i++)
+        for (j = 0; j < 10000; j++)
+            x = x * 1103515245 + 12345;
+
+    return 0;
+}
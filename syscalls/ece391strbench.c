@@ -0,0 +1,112 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+#define MAX_LEN 1024
+#define REPS 2000
+
+static uint8_t str1[MAX_LEN + 8];
+static uint8_t str2[MAX_LEN + 8];
+
+/* Byte-at-a-time versions the library used before */
+static uint32_t
+byte_strlen (const uint8_t* s)
+{
+    uint32_t len;
+
+    for (len = 0; '\0' != *s; s++, len++);
+    return len;
+}
+
+static int32_t
+byte_strncmp (const uint8_t* s1, const uint8_t* s2, uint32_t n)
+{
+    if (0 == n)
+        return 0;
+    while (*s1 == *s2) {
+        if (*s1 == '\0' || --n == 0)
+            return 0;
+        s1++;
+        s2++;
+    }
+    return ((int32_t)*s1) - ((int32_t)*s2);
+}
+
+static inline uint32_t
+rdtsc (void)
+{
+    uint32_t low, high;
+
+    asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+    return low;
+}
+
+static void
+put_num (const char* label, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+/*
+ * Compares the word-at-a-time ece391_strlen and ece391_strncmp with the
+ * byte loops they replaced, on equal strings of 8 to 512 bytes. Prints
+ * TSC cycles per call for each and reports any result that differs.
+ */
+int main ()
+{
+    uint32_t len, i, r, t0, t1;
+    uint32_t old_len, new_len, old_cmp, new_cmp;
+    volatile uint32_t sink = 0;
+
+    for (len = 8; len <= MAX_LEN; len <<= 2) {
+        for (i = 0; i < len; i++)
+            str1[i] = str2[i] = 'a' + (i % 26);
+        str1[len] = str2[len] = '\0';
+
+        if (byte_strlen (str1) != ece391_strlen (str1) ||
+            byte_strncmp (str1, str2, MAX_LEN) != ece391_strncmp (str1, str2, MAX_LEN)) {
+            put_num ("mismatch at length ", len);
+            ece391_fdputs (1, (uint8_t*)"\n");
+            return 3;
+        }
+
+        t0 = rdtsc ();
+        for (r = 0; r < REPS; r++)
+            sink += byte_strlen (str1);
+        t1 = rdtsc ();
+        old_len = (t1 - t0) / REPS;
+
+        t0 = rdtsc ();
+        for (r = 0; r < REPS; r++)
+            sink += ece391_strlen (str1);
+        t1 = rdtsc ();
+        new_len = (t1 - t0) / REPS;
+
+        t0 = rdtsc ();
+        for (r = 0; r < REPS; r++)
+            sink += byte_strncmp (str1, str2, MAX_LEN);
+        t1 = rdtsc ();
+        old_cmp = (t1 - t0) / REPS;
+
+        t0 = rdtsc ();
+        for (r = 0; r < REPS; r++)
+            sink += ece391_strncmp (str1, str2, MAX_LEN);
+        t1 = rdtsc ();
+        new_cmp = (t1 - t0) / REPS;
+
+        put_num ("len ", len);
+        put_num (": strlen ", old_len);
+        put_num (" -> ", new_len);
+        put_num (" cycles, strncmp ", old_cmp);
+        put_num (" -> ", new_cmp);
+        ece391_fdputs (1, (uint8_t*)" cycles\n");
+    }
+
+    return 0;
+}
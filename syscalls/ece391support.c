@@ -3,12 +3,28 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
+/*
+ * Word-at-a-time string scanning: a word holds a zero byte exactly when
+ * subtracting 1 from each byte borrows into a high bit that was clear.
+ * Aligned word reads never cross into the next page.
+ */
+#define WORD_SIZE 4
+#define WORD_MASK (WORD_SIZE - 1)
+#define HAS_ZERO_BYTE(w) (((w) - 0x01010101) & ~(w) & 0x80808080)
+
 uint32_t ece391_strlen(const uint8_t* s)
 {
-    uint32_t len;
+    const uint8_t* p = s;
+    const uint32_t* w;
+
+    for (; (uint32_t)p & WORD_MASK; p++)
+        if ('\0' == *p)
+            return p - s;
+
+    for (w = (const uint32_t*)p; !HAS_ZERO_BYTE (*w); w++);
 
-    for (len = 0; '\0' != *s; s++, len++);
-    return len;
+    for (p = (const uint8_t*)w; '\0' != *p; p++);
+    return p - s;
 }
 
 void ece391_strcpy(uint8_t* dst, const uint8_t* src)
@@ -34,13 +50,30 @@ int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2)
 
 int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n)
 {
+    uint32_t w;
+
     if (0 == n)
         return 0;
+
+    /* Equally aligned strings compare a word at a time until a word
+     * differs or holds the terminator, the byte loop finds which */
+    if (0 == (((uint32_t)s1 ^ (uint32_t)s2) & WORD_MASK)) {
+        for (; ((uint32_t)s1 & WORD_MASK) && n > 1; s1++, s2++, n--)
+            if (*s1 != *s2 || '\0' == *s1)
+                return ((int32_t)*s1) - ((int32_t)*s2);
+
+        for (; n > WORD_SIZE; s1 += WORD_SIZE, s2 += WORD_SIZE, n -= WORD_SIZE) {
+            w = *(const uint32_t*)s1;
+            if (w != *(const uint32_t*)s2 || HAS_ZERO_BYTE (w))
+                break;
+        }
+    }
+
     while (*s1 == *s2) {
         if (*s1 == '\0' || --n == 0)
-        return 0;
-    s1++;
-    s2++;
+            return 0;
+        s1++;
+        s2++;
     }
     return ((int32_t)*s1) - ((int32_t)*s2);
 }
@@ -102,3 +135,117 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+
+/*
+ * Heap allocator.  Small requests are rounded up to a power-of-two size
+ * class and served from per-class free lists; blocks are carved out of an
+ * arena that grows by MALLOC_CHUNK bytes per sbrk call, so most allocations
+ * never trap into the kernel.  Requests above the largest class get an
+ * exact-size block and are recycled through a first-fit list.
+ */
+#define MALLOC_MIN_SHIFT   4        /* smallest class is 16 bytes */
+#define MALLOC_NUM_CLASSES 8        /* 16 B .. 2 KB */
+#define MALLOC_LARGE       MALLOC_NUM_CLASSES
+#define MALLOC_ALIGN       8
+#define MALLOC_CHUNK       16384
+
+typedef struct malloc_hdr {
+    uint32_t size_class;            /* MALLOC_LARGE for oversized blocks */
+    uint32_t size;                  /* block size including header */
+} malloc_hdr_t;
+
+typedef struct free_block {
+    malloc_hdr_t hdr;
+    struct free_block* next;
+} free_block_t;
+
+static free_block_t* free_lists[MALLOC_NUM_CLASSES];
+static free_block_t* large_list;
+static uint8_t* arena_cur;
+static uint8_t* arena_end;
+
+/* Take n bytes from the arena, growing it with sbrk when exhausted */
+static void* arena_alloc(uint32_t n)
+{
+    uint32_t grow;
+    uint8_t* mem;
+    void* ret;
+
+    if (arena_end - arena_cur < n) {
+        grow = (n + MALLOC_CHUNK - 1) & ~(MALLOC_CHUNK - 1);
+        mem = ece391_sbrk (grow);
+        if ((void*)-1 == mem)
+            return 0;
+        /* The break only moves for us, so the arena normally extends */
+        if (mem != arena_end)
+            arena_cur = mem;
+        arena_end = mem + grow;
+    }
+
+    ret = arena_cur;
+    arena_cur += n;
+    return ret;
+}
+
+void* ece391_malloc(uint32_t size)
+{
+    uint32_t total, class, block;
+    free_block_t* blk;
+    free_block_t** prev;
+
+    if (0 == size)
+        return 0;
+
+    total = (size + sizeof (malloc_hdr_t) + MALLOC_ALIGN - 1) & ~(MALLOC_ALIGN - 1);
+
+    for (class = 0; class < MALLOC_NUM_CLASSES; class++) {
+        if ((1 << (class + MALLOC_MIN_SHIFT)) >= total)
+            break;
+    }
+
+    if (class < MALLOC_NUM_CLASSES) {
+        block = 1 << (class + MALLOC_MIN_SHIFT);
+        blk = free_lists[class];
+        if (0 != blk) {
+            free_lists[class] = blk->next;
+        } else if (0 == (blk = arena_alloc (block))) {
+            return 0;
+        }
+    } else {
+        /* First fit among previously freed large blocks */
+        for (prev = &large_list; 0 != *prev; prev = &(*prev)->next) {
+            if ((*prev)->hdr.size >= total)
+                break;
+        }
+        if (0 != *prev) {
+            blk = *prev;
+            *prev = blk->next;
+            block = blk->hdr.size;
+        } else {
+            block = total;
+            if (0 == (blk = arena_alloc (block)))
+                return 0;
+        }
+    }
+
+    blk->hdr.size_class = class;
+    blk->hdr.size = block;
+    return (uint8_t*)blk + sizeof (malloc_hdr_t);
+}
+
+void ece391_free(void* ptr)
+{
+    free_block_t* blk;
+
+    if (0 == ptr)
+        return;
+
+    blk = (free_block_t*)((uint8_t*)ptr - sizeof (malloc_hdr_t));
+    if (blk->hdr.size_class < MALLOC_NUM_CLASSES) {
+        blk->next = free_lists[blk->hdr.size_class];
+        free_lists[blk->hdr.size_class] = blk;
+    } else {
+        blk->next = large_list;
+        large_list = blk;
+    }
+}
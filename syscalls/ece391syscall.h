@@ -22,6 +22,211 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * Moves the program break by "increment" bytes and returns the old break,
+ * or (void*)-1 on failure.  Heap pages are zero-filled on first touch.
+ */
+extern void* ece391_sbrk (int32_t increment);
+
+/*
+ * A command ending in '&' is started in the background: execute returns
+ * its pid at once and wait blocks until it halts, returning its status.
+ */
+extern int32_t ece391_wait (int32_t pid);
+
+/* Per-CPU scheduler counters filled in by ece391_schedstat */
+typedef struct sched_stat_t {
+	uint32_t ticks;
+	uint32_t nr_running;
+	uint32_t steals;
+	uint32_t stolen;
+	uint32_t switches;
+} sched_stat_t;
+
+/* Copies counters of up to n CPUs into buf, returns the number online */
+extern int32_t ece391_schedstat (sched_stat_t* buf, int32_t n);
+
+/* Disk buffer cache counters filled in by ece391_bcachestat */
+typedef struct bcache_stat_t {
+	uint32_t blocks;
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t readahead;
+	uint32_t ra_hits;
+	uint32_t evictions;
+	uint32_t writebacks;
+} bcache_stat_t;
+
+/* Copies the buffer cache counters into buf, returns 0 or -1 */
+extern int32_t ece391_bcachestat (bcache_stat_t* buf);
+
+/* Request queue counters of a disk filled in by ece391_iostat. Bucket i of
+ * hist counts requests that took under 2^(i + 15) TSC cycles from being
+ * queued to completing; the last bucket holds everything slower. */
+#define IO_HIST_BUCKETS 16
+#define IO_HIST_SHIFT 14
+typedef struct io_stat_t {
+	int8_t sched[16];
+	uint32_t queued;
+	uint32_t merged;
+	uint32_t dispatched;
+	uint32_t expired;
+	uint32_t sectors;
+	uint32_t hist[IO_HIST_BUCKETS];
+} io_stat_t;
+
+/* Switches disk dev ("hda" is 0) to the "noop" or "deadline" I/O
+ * scheduler, clearing its counters and its clean cached blocks */
+extern int32_t ece391_iosched (int32_t dev, const uint8_t* name);
+/* Copies the request queue counters of disk dev into buf */
+extern int32_t ece391_iostat (int32_t dev, io_stat_t* buf);
+
+/*
+ * Submission and completion rings for ece391_ring_enter, kept in the
+ * program's own memory (static data or the heap). Indices run freely and
+ * are taken modulo IORING_ENTRIES. The program fills sq[sq_tail] and
+ * advances sq_tail, and reaps cq[cq_head] while cq_head != cq_tail.
+ */
+#define IORING_ENTRIES 32
+#define IORING_MASK (IORING_ENTRIES - 1)
+#define IORING_OP_NOP 0
+#define IORING_OP_READ 1
+#define IORING_OP_WRITE 2
+typedef struct io_sqe_t {
+	uint32_t opcode;
+	int32_t fd;
+	void* buf;
+	int32_t len;
+	uint32_t user_data;
+} io_sqe_t;
+typedef struct io_cqe_t {
+	uint32_t user_data;
+	int32_t res;
+} io_cqe_t;
+typedef struct io_ring_t {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	io_sqe_t sq[IORING_ENTRIES];
+	io_cqe_t cq[IORING_ENTRIES];
+} io_ring_t;
+
+/* Runs up to to_submit queued reads and writes in order with one trap,
+ * posting each result as a completion. Returns the number consumed. */
+extern int32_t ece391_ring_enter (io_ring_t* ring, uint32_t to_submit);
+
+/*
+ * Descriptors watched by ece391_poll. It sleeps until one of the events
+ * asked for is ready on some entry (stdin: a line was entered, rtc: a tick
+ * came since the last read), for at most timeout timer ticks (about 60 a
+ * second; 0 only tests, negative waits without limit). Returns the number
+ * of entries with revents set, 0 on timeout.
+ */
+#define POLLIN 0x0001
+#define POLLOUT 0x0004
+#define POLLERR 0x0008
+#define POLLHUP 0x0010
+#define POLLNVAL 0x0020
+typedef struct pollfd_t {
+	int32_t fd;
+	uint16_t events;
+	uint16_t revents;
+} pollfd_t;
+
+extern int32_t ece391_poll (pollfd_t* fds, int32_t nfds, int32_t timeout);
+
+/*
+ * ece391_fcntl (fd, F_GETFL, 0) returns the status flags of fd and
+ * ece391_fcntl (fd, F_SETFL, flags) sets them. With O_NONBLOCK set, a read
+ * of stdin or the rtc that would wait returns -EAGAIN at once instead; a
+ * line typed meanwhile is returned by a later read.
+ */
+#define F_GETFL 3
+#define F_SETFL 4
+#define O_NONBLOCK 0x0800
+#define EAGAIN 11
+extern int32_t ece391_fcntl (int32_t fd, int32_t cmd, int32_t arg);
+
+/*
+ * Vectored I/O: up to IOV_MAX buffers are read or written in order with
+ * one call, which returns the total byte count. readv stops after a short
+ * read. On the terminal a segment may hold at most 4096 bytes, as for write.
+ */
+#define IOV_MAX 16
+typedef struct iovec_t {
+	void* base;
+	uint32_t len;
+} iovec_t;
+extern int32_t ece391_readv (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+/*
+ * ece391_getdents fills buf, nbytes long, with as many entries of the
+ * directory open on fd as fit and returns the bytes filled, 0 once every
+ * entry has been returned.
+ */
+#define TYPE_RTC 0
+#define TYPE_DIR 1
+#define TYPE_FILE 2
+#define TYPE_TERM 3
+#define DIRENT_NAME_LEN 32
+typedef struct dirent_t {
+	uint32_t inode_num;
+	uint32_t f_type;
+	uint32_t length;
+	uint8_t fname[DIRENT_NAME_LEN + 1];
+} dirent_t;
+extern int32_t ece391_getdents (int32_t fd, dirent_t* buf, int32_t nbytes);
+
+/*
+ * File type, inode, length in bytes and data blocks of a file by name
+ * (ece391_stat) or of an open descriptor (ece391_fstat). The length is 0
+ * for anything but a regular file; stdin and stdout are TYPE_TERM.
+ */
+typedef struct stat_t {
+	uint32_t f_type;
+	uint32_t inode_num;
+	uint32_t length;
+	uint32_t blocks;
+} stat_t;
+extern int32_t ece391_stat (const uint8_t* fname, stat_t* buf);
+extern int32_t ece391_fstat (int32_t fd, stat_t* buf);
+
+/*
+ * ece391_lseek moves the position of a file (in bytes) or the directory
+ * (in entries) and returns it; positions past the end are refused.
+ * ece391_pread reads a file at offset without using or moving it.
+ */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, int32_t offset);
+
+/*
+ * ece391_dup returns the lowest free descriptor, ece391_dup2 newfd (closed
+ * first if open), made to refer to the same open file as fd: they share
+ * its position and flags. Descriptors are inherited by execute, so a
+ * shell can redirect a child's stdin or stdout with dup2 before running it.
+ */
+extern int32_t ece391_dup (int32_t fd);
+extern int32_t ece391_dup2 (int32_t fd, int32_t newfd);
+
+/*
+ * Latency of a tasklet (deferred interrupt work) from being queued by its
+ * IRQ to starting, in TSC cycles, filled in by ece391_softirqstat. It
+ * copies up to n tasklets into buf and returns how many there are.
+ */
+#define TASKLET_NAME_LEN 16
+typedef struct softirq_stat_t {
+	int8_t name[TASKLET_NAME_LEN];
+	uint32_t runs;
+	uint32_t total_latency;
+	uint32_t max_latency;
+} softirq_stat_t;
+extern int32_t ece391_softirqstat (softirq_stat_t* buf, int32_t n);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
@@ -11,5 +11,24 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SBRK    11
+#define SYS_WAIT    12
+#define SYS_SCHEDSTAT 13
+#define SYS_BCACHESTAT 14
+#define SYS_IOSCHED 15
+#define SYS_IOSTAT 16
+#define SYS_RING_ENTER 17
+#define SYS_POLL 18
+#define SYS_FCNTL 19
+#define SYS_READV 20
+#define SYS_WRITEV 21
+#define SYS_GETDENTS 22
+#define SYS_STAT 23
+#define SYS_FSTAT 24
+#define SYS_LSEEK 25
+#define SYS_PREAD 26
+#define SYS_DUP 27
+#define SYS_DUP2 28
+#define SYS_SOFTIRQSTAT 29
 
 #endif /* ECE391SYSNUM_H */